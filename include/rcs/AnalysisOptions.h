@@ -0,0 +1,23 @@
+// AnalysisOptions is an interface for analyses whose results depend on
+// command-line options. It is an AnalysisGroup without a default instance,
+// so that clients caching results across runs, such as FPCallGraph with
+// -fpcg-cache-dir, can find every implementation in the pass manager and
+// hash the options it prints.
+
+#ifndef __RCS_ANALYSIS_OPTIONS_H
+#define __RCS_ANALYSIS_OPTIONS_H
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace rcs {
+struct AnalysisOptions {
+  // A must for an AnalysisGroup.
+  static char ID;
+
+  virtual ~AnalysisOptions() {}
+  // Prints the options that may change the results of the analysis.
+  virtual void printOptions(llvm::raw_ostream &O) const = 0;
+};
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Recovers the class hierarchy and the vtable layouts of a C++ module from
+// its vtable (_ZTV) and typeinfo (_ZTI) globals, and resolves virtual calls
+// with them.
+
+#ifndef __RCS_CLASS_HIERARCHY_H
+#define __RCS_CLASS_HIERARCHY_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "llvm/Constants.h"
+#include "llvm/Module.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CallSite.h"
+
+#include "rcs/typedefs.h"
+
+using namespace llvm;
+
+namespace rcs {
+struct ClassHierarchy {
+  void build(Module &M);
+  void clear();
+  // Adds to <Callees> the defined functions the virtual call <CS> may call.
+  // Returns false if <CS> does not look like a virtual call, the static
+  // class has no typeinfo, the module lacks the vtable of the class or of
+  // one of its subclasses, a subclass does not have exactly one address
+  // point for the subobject of the static class, or no vtable has an entry
+  // for it.
+  bool getVirtualCallees(const CallSite &CS, FuncList &Callees) const;
+
+ private:
+  struct ClassInfo {
+    ClassInfo(): VTable(NULL), HasTypeInfo(false) {}
+    // The initializer of the class's vtable, if the module defines it.
+    ConstantArray *VTable;
+    // Whether the module defines the class's typeinfo, and so names all its
+    // bases.
+    bool HasTypeInfo;
+    // Indexes in <VTable> that constructors store into objects. Empty if the
+    // class is never instantiated (rapid type analysis).
+    std::vector<unsigned> AddressPoints;
+    // Mangled names of the direct subclasses, and the offsets of this class
+    // in them, or UnknownOffset for virtual bases.
+    std::vector<std::pair<std::string, int64_t> > Derived;
+  };
+  static const int64_t UnknownOffset = INT64_MIN;
+
+  static std::string getMangledName(Type *T);
+  static bool getVTableSlot(Value *FP, Value *&Object, unsigned &Slot);
+  static bool getOffsetToTop(const ClassInfo &C, unsigned AddressPoint,
+                             int64_t &Offset);
+  bool collectSubclasses(const std::string &Name, int64_t Offset,
+                         StringMap<int64_t> &Visited,
+                         std::vector<std::pair<const ClassInfo *, int64_t> >
+                             &Result) const;
+  static bool addCallees(const ClassInfo &C, int64_t Offset, unsigned Slot,
+                         unsigned NumArgs, FuncList &Callees);
+
+  // Keyed by mangled class names, e.g. "1A" or "N2ns1BE".
+  StringMap<ClassInfo> Classes;
+};
+}
+
+#endif
@@ -0,0 +1,37 @@
+// A raw_ostream that computes the 64-bit FNV-1a hash of everything written
+// to it, such as a printed module. Used to tell whether a file on disk was
+// computed from the module at hand.
+
+#ifndef __RCS_FNV_HASH_STREAM_H
+#define __RCS_FNV_HASH_STREAM_H
+
+#include <stdint.h>
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace rcs {
+struct FNVHashStream: public llvm::raw_ostream {
+  FNVHashStream(): Hash(14695981039346656037ULL), Pos(0) {}
+  ~FNVHashStream() { flush(); }
+
+  uint64_t getHash() {
+    flush();
+    return Hash;
+  }
+
+ private:
+  virtual void write_impl(const char *Ptr, size_t Size) {
+    for (size_t i = 0; i < Size; ++i) {
+      Hash ^= (unsigned char)Ptr[i];
+      Hash *= 1099511628211ULL;
+    }
+    Pos += Size;
+  }
+  virtual uint64_t current_pos() const { return Pos; }
+
+  uint64_t Hash;
+  uint64_t Pos;
+};
+}
+
+#endif
@@ -4,12 +4,19 @@
 #ifndef __RCS_FP_CALLGRAPH_H
 #define __RCS_FP_CALLGRAPH_H
 
+#include <pthread.h>
+
+#include <string>
 #include <vector>
 
 #include "llvm/Module.h"
+#include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 
+#include "rcs/ClassHierarchy.h"
+#include "rcs/PointerAnalysis.h"
 #include "rcs/typedefs.h"
 
 using namespace llvm;
@@ -23,6 +30,7 @@ struct FPCallGraph: public ModulePass, public CallGraph {
 
   // Interfaces of ModulePass
   FPCallGraph();
+  virtual ~FPCallGraph();
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   virtual bool runOnModule(Module &M);
   virtual void print(raw_ostream &O, const Module *M) const;
@@ -42,22 +50,107 @@ struct FPCallGraph: public ModulePass, public CallGraph {
   CallGraphNode *getCallsExternalNode() const { return CallsExternNode; }
   virtual void destroy();
 
-  FuncList getCalledFunctions(const Instruction *Ins) const;
-  InstList getCallSites(const Function *F) const;
+  // The returned ranges are valid until the pass is rerun.
+  ArrayRef<Function *> getCalledFunctions(const Instruction *Ins) const;
+  ArrayRef<Instruction *> getCallSites(const Function *F) const;
+
+  // Updates the call graph after a transform edited, added or removed a few
+  // functions, without resolving every call site again. <Changed> holds the
+  // edited and the added functions. <Removed> holds the functions about to
+  // be removed, which must still be in the module. The call sites of
+  // <Changed> are resolved again. Other indirect call sites only drop
+  // functions that are no longer candidates, and query alias analysis about
+  // the new candidates. The root is kept unless it is removed, in which case
+  // the external calling node becomes the root, as if the module had no
+  // main. A transform that preserves FPCallGraph calls it after editing call
+  // sites. -fpcg-check-update runs it on every other function as a check.
+  void updateFunctions(Module &M, const FuncSet &Changed,
+                       const FuncSet &Removed);
+
+  // The SCCs of the call graph reachable from the root, computed once.
+  // SCC IDs are in reverse topological order, i.e. an SCC only calls SCCs
+  // with smaller or equal IDs. Bottom-up clients iterate from 0 and
+  // top-down clients from getNumSCCs() - 1.
+  unsigned getNumSCCs() const { return SCCOffsets.size() - 1; }
+  // Returns ~0U if <F> is not reachable from the root.
+  unsigned getSCCID(const Function *F) const;
+  // Functions in SCC <ID>. The nodes without a function, i.e. the external
+  // calling node and the calls-external node, are left out.
+  ArrayRef<Function *> getSCC(unsigned ID) const;
+  // Whether SCC <ID> has a cycle, i.e. more than one function or a
+  // recursive function.
+  bool sccHasLoop(unsigned ID) const { return SCCHasLoop[ID]; }
 
  protected:
+  // Only effective before finalizeCallGraph.
   void addCallEdge(const CallSite &CS, Function *Callee);
 
  private:
   template <typename T>
   static void MakeUnique(std::vector<T> &V);
 
-  void processCallSite(const CallSite &CS, const FuncSet &AllFuncs);
-  void simplifyCallGraph();
-
+  struct ResolveBody;
+  friend struct ResolveBody;
+
+  // Appends to <Callees> the functions <CS> may call.
+  void resolveCallSite(const CallSite &CS, FuncList &Callees);
+  void getIndirectCallees(Value *FP, unsigned MinArgs, unsigned NumArgs,
+                          FuncList &Callees);
+  bool getCalleesFromPA(Value *FP, FuncList &Callees);
+  bool resolveWithoutAA(const CallSite &CS, Value *FP, FuncList &Callees);
+  bool mayPointTo(Value *FP, Function *F);
+  bool canResolveInParallel();
+  void resolveCallSites(Module &M);
+  void resolveCallSitesInParallel(const InstList &Sites);
+  void collectCandidates(Module &M, const FuncSet &Removed);
+  void rebuildCallEdges(Function *F);
+  void checkUpdate(Module &M);
+  void finalizeCallGraph(Module &M);
+  void computeSCCs();
+  uint64_t computeCacheKey(Module &M);
+  std::string getCachePath(uint64_t Key) const;
+  bool loadCache(uint64_t Key);
+  void writeCache(Module &M, uint64_t Key);
+
+  // Edges being built. finalizeCallGraph moves them into the CSR arrays
+  // below and frees them.
   SiteToFuncsMapTy SiteToFuncs;
   FuncToSitesMapTy FuncToSites;
 
+  // The callees of call site S are SiteCallees[CalleeOffsets[SiteIDs[S]],
+  // CalleeOffsets[SiteIDs[S] + 1]), and similarly the call sites of a
+  // function.
+  DenseMap<const Instruction *, unsigned> SiteIDs;
+  std::vector<unsigned> CalleeOffsets;
+  FuncList SiteCallees;
+  DenseMap<const Function *, unsigned> FuncIDs;
+  std::vector<unsigned> CallSiteOffsets;
+  InstList FuncCallSites;
+
+  // Function F is in SCCFuncs[SCCOffsets[SCCIDs[F]],
+  // SCCOffsets[SCCIDs[F] + 1]).
+  DenseMap<const Function *, unsigned> SCCIDs;
+  std::vector<unsigned> SCCOffsets;
+  FuncList SCCFuncs;
+  std::vector<bool> SCCHasLoop;
+
+  // Candidate targets of indirect calls: the defined functions whose
+  // addresses are taken. A call with N arguments can only target functions
+  // with N parameters, or vararg functions with at most N fixed ones. Thread
+  // functions may also have no parameter.
+  FuncList AddressTakenFuncs;
+  DenseMap<unsigned, FuncList> FuncsByArity;
+  FuncList VarArgFuncs;
+  // Resolves virtual calls with -fpcg-cha.
+  ClassHierarchy CHA;
+  // Cached in runOnModule, because worker threads shouldn't call getAnalysis.
+  AliasAnalysis *AA;
+  PointerAnalysis *PA;
+  // Alias analyses may update caches even when answering queries, so worker
+  // threads take turns asking them.
+  pthread_mutex_t AAMutex;
+  bool LockAA;
+
   CallGraphNode *Root;
   CallGraphNode *ExternCallingNode;
   CallGraphNode *CallsExternNode;
@@ -0,0 +1,703 @@
+// A set of unsigned integers that picks its representation by density.
+//
+// Small sets are sorted arrays of elements. Larger sets are either sorted
+// vectors of 128-bit chunks, like llvm::SparseBitVector but contiguous in
+// memory, or dense arrays of 64-bit words covering the span of the set,
+// whichever takes less memory. Unions, differences and intersection tests of
+// two dense sets run word-parallel kernels that use AVX2 or SSE2 when the
+// compiler targets them, and plain 64-bit operations otherwise.
+//
+// Every operation leaves the set in the form its new size calls for, so
+// callers never choose the form themselves. The interface follows the parts
+// of llvm::SparseBitVector that points-to solvers use, so that one can stand
+// in for the other.
+
+#ifndef __RCS_HYBRID_BIT_SET_H
+#define __RCS_HYBRID_BIT_SET_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace rcs {
+namespace hybrid_bit_set_detail {
+// The kernels work on the N words of each operand.
+
+// Dst |= Src. Returns whether Dst changed.
+inline bool OrWords(uint64_t *Dst, const uint64_t *Src, size_t N) {
+  size_t I = 0;
+  bool Changed = false;
+#if defined(__AVX2__)
+  for (; I + 4 <= N; I += 4) {
+    __m256i D = _mm256_loadu_si256((const __m256i *)(Dst + I));
+    __m256i S = _mm256_loadu_si256((const __m256i *)(Src + I));
+    __m256i New = _mm256_andnot_si256(D, S);
+    if (!_mm256_testz_si256(New, New)) {
+      Changed = true;
+      _mm256_storeu_si256((__m256i *)(Dst + I), _mm256_or_si256(D, S));
+    }
+  }
+#elif defined(__SSE2__)
+  const __m128i Zero = _mm_setzero_si128();
+  for (; I + 2 <= N; I += 2) {
+    __m128i D = _mm_loadu_si128((const __m128i *)(Dst + I));
+    __m128i S = _mm_loadu_si128((const __m128i *)(Src + I));
+    __m128i New = _mm_andnot_si128(D, S);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(New, Zero)) != 0xFFFF) {
+      Changed = true;
+      _mm_storeu_si128((__m128i *)(Dst + I), _mm_or_si128(D, S));
+    }
+  }
+#endif
+  for (; I < N; ++I) {
+    if (Src[I] & ~Dst[I]) {
+      Changed = true;
+      Dst[I] |= Src[I];
+    }
+  }
+  return Changed;
+}
+
+// Dst = A & ~B.
+inline void AndNotWords(uint64_t *Dst, const uint64_t *A, const uint64_t *B,
+                        size_t N) {
+  size_t I = 0;
+#if defined(__AVX2__)
+  for (; I + 4 <= N; I += 4) {
+    __m256i X = _mm256_loadu_si256((const __m256i *)(A + I));
+    __m256i Y = _mm256_loadu_si256((const __m256i *)(B + I));
+    _mm256_storeu_si256((__m256i *)(Dst + I), _mm256_andnot_si256(Y, X));
+  }
+#elif defined(__SSE2__)
+  for (; I + 2 <= N; I += 2) {
+    __m128i X = _mm_loadu_si128((const __m128i *)(A + I));
+    __m128i Y = _mm_loadu_si128((const __m128i *)(B + I));
+    _mm_storeu_si128((__m128i *)(Dst + I), _mm_andnot_si128(Y, X));
+  }
+#endif
+  for (; I < N; ++I)
+    Dst[I] = A[I] & ~B[I];
+}
+
+// Returns whether A & B is not all zeros.
+inline bool IntersectWords(const uint64_t *A, const uint64_t *B, size_t N) {
+  size_t I = 0;
+#if defined(__AVX2__)
+  for (; I + 4 <= N; I += 4) {
+    __m256i X = _mm256_loadu_si256((const __m256i *)(A + I));
+    __m256i Y = _mm256_loadu_si256((const __m256i *)(B + I));
+    if (!_mm256_testz_si256(X, Y))
+      return true;
+  }
+#elif defined(__SSE2__)
+  const __m128i Zero = _mm_setzero_si128();
+  for (; I + 2 <= N; I += 2) {
+    __m128i X = _mm_loadu_si128((const __m128i *)(A + I));
+    __m128i Y = _mm_loadu_si128((const __m128i *)(B + I));
+    __m128i Both = _mm_and_si128(X, Y);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(Both, Zero)) != 0xFFFF)
+      return true;
+  }
+#endif
+  for (; I < N; ++I) {
+    if (A[I] & B[I])
+      return true;
+  }
+  return false;
+}
+
+inline unsigned CountWords(const uint64_t *A, size_t N) {
+  unsigned Count = 0;
+  for (size_t I = 0; I < N; ++I)
+    Count += __builtin_popcountll(A[I]);
+  return Count;
+}
+}
+
+class HybridBitSet {
+ public:
+  enum Form { Array, Chunked, Dense };
+
+  // Sets with at most this many elements are arrays.
+  static const unsigned ArrayLimit = 16;
+
+  /// iterator - Walks the elements in ascending order. Invalidated by any
+  /// change to the set.
+  class iterator {
+    const HybridBitSet *S;
+    // The index into Elements of an array, or the index of the word being
+    // walked otherwise.
+    size_t Pos;
+    // The bits of that word not walked yet, and the element of its bit 0.
+    uint64_t Bits;
+    unsigned Base;
+
+    void skipEmptyWords() {
+      if (S->F == Array)
+        return;
+      size_t NumWords = S->getNumWords();
+      while (!Bits) {
+        if (++Pos >= NumWords) {
+          Pos = NumWords;
+          return;
+        }
+        Bits = S->getWordAt(Pos, Base);
+      }
+    }
+
+   public:
+    iterator(const HybridBitSet *Set, bool End)
+        : S(Set), Pos(0), Bits(0), Base(0) {
+      if (End) {
+        Pos = (S->F == Array ? S->Elements.size() : S->getNumWords());
+        return;
+      }
+      if (S->F != Array && S->getNumWords() > 0)
+        Bits = S->getWordAt(0, Base);
+      skipEmptyWords();
+    }
+
+    unsigned operator*() const {
+      if (S->F == Array)
+        return S->Elements[Pos];
+      return Base + __builtin_ctzll(Bits);
+    }
+
+    iterator &operator++() {
+      if (S->F == Array) {
+        ++Pos;
+      } else {
+        Bits &= Bits - 1;
+        skipEmptyWords();
+      }
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator Old = *this;
+      ++*this;
+      return Old;
+    }
+
+    bool operator==(const iterator &RHS) const {
+      return Pos == RHS.Pos && Bits == RHS.Bits;
+    }
+    bool operator!=(const iterator &RHS) const { return !(*this == RHS); }
+  };
+
+  HybridBitSet(): F(Array), FirstWord(0) {}
+
+  iterator begin() const { return iterator(this, false); }
+  iterator end() const { return iterator(this, true); }
+
+  /// assign - Make the set hold the elements in [Begin, End), which must be
+  /// ascending. Works with any iterator over unsigned values, such as the
+  /// one of llvm::SparseBitVector.
+  template <class IteratorTy>
+  void assign(IteratorTy Begin, IteratorTy End) {
+    std::vector<Chunk> Cs;
+    for (; Begin != End; ++Begin)
+      AppendToChunks(Cs, *Begin);
+    SetFromChunks(Cs);
+  }
+
+  Form getForm() const { return F; }
+
+  bool empty() const {
+    switch (F) {
+      case Array: return Elements.empty();
+      case Chunked: return Chunks.empty();
+      case Dense: return Words.empty();
+    }
+    return true;
+  }
+
+  unsigned count() const {
+    switch (F) {
+      case Array:
+        return Elements.size();
+      case Chunked: {
+        unsigned Count = 0;
+        for (size_t I = 0; I < Chunks.size(); ++I)
+          Count += __builtin_popcountll(Chunks[I].W[0]) +
+              __builtin_popcountll(Chunks[I].W[1]);
+        return Count;
+      }
+      case Dense:
+        return hybrid_bit_set_detail::CountWords(&Words[0], Words.size());
+    }
+    return 0;
+  }
+
+  bool test(unsigned X) const {
+    switch (F) {
+      case Array:
+        return std::binary_search(Elements.begin(), Elements.end(), X);
+      case Chunked: {
+        std::vector<Chunk>::const_iterator I =
+            std::lower_bound(Chunks.begin(), Chunks.end(), X / 128,
+                             ChunkIndexLess());
+        return I != Chunks.end() && I->Index == X / 128 &&
+            (I->W[X / 64 % 2] >> (X % 64) & 1);
+      }
+      case Dense:
+        return X / 64 >= FirstWord && X / 64 - FirstWord < Words.size() &&
+            (Words[X / 64 - FirstWord] >> (X % 64) & 1);
+    }
+    return false;
+  }
+
+  /// find_first - Return the smallest element, or -1 if the set is empty.
+  int find_first() const {
+    return empty() ? -1 : (int)*begin();
+  }
+
+  /// set - Add X. Returns whether it was new. Adding to an existing chunk or
+  /// word, or to a small array, is done in place.
+  bool set(unsigned X) {
+    switch (F) {
+      case Array: {
+        std::vector<unsigned>::iterator I =
+            std::lower_bound(Elements.begin(), Elements.end(), X);
+        if (I != Elements.end() && *I == X)
+          return false;
+        if (Elements.size() < ArrayLimit) {
+          Elements.insert(I, X);
+          return true;
+        }
+        break;
+      }
+      case Chunked: {
+        std::vector<Chunk>::iterator I =
+            std::lower_bound(Chunks.begin(), Chunks.end(), X / 128,
+                             ChunkIndexLess());
+        if (I != Chunks.end() && I->Index == X / 128)
+          return SetBit(I->W[X / 64 % 2], X);
+        break;
+      }
+      case Dense:
+        if (X / 64 >= FirstWord && X / 64 - FirstWord < Words.size())
+          return SetBit(Words[X / 64 - FirstWord], X);
+        break;
+    }
+    HybridBitSet Single;
+    Single.Elements.push_back(X);
+    return *this |= Single;
+  }
+
+  bool test_and_set(unsigned X) { return set(X); }
+
+  /// reset - Remove X.
+  void reset(unsigned X) {
+    if (!test(X))
+      return;
+    HybridBitSet Single;
+    Single.Elements.push_back(X);
+    intersectWithComplement(*this, Single);
+  }
+
+  void clear() { *this = HybridBitSet(); }
+
+  /// toVector - Append the elements in ascending order to Out.
+  void toVector(std::vector<unsigned> &Out) const {
+    if (F == Array) {
+      Out.insert(Out.end(), Elements.begin(), Elements.end());
+      return;
+    }
+    ChunkCursor C(*this);
+    for (; !C.done(); C.next()) {
+      for (unsigned H = 0; H < 2; ++H) {
+        for (uint64_t W = C.get().W[H]; W; W &= W - 1)
+          Out.push_back(C.get().Index * 128 + H * 64 + __builtin_ctzll(W));
+      }
+    }
+  }
+
+  bool operator==(const HybridBitSet &RHS) const {
+    ChunkCursor A(*this), B(RHS);
+    for (; !A.done() && !B.done(); A.next(), B.next()) {
+      if (A.get().Index != B.get().Index || A.get().W[0] != B.get().W[0] ||
+          A.get().W[1] != B.get().W[1])
+        return false;
+    }
+    return A.done() && B.done();
+  }
+  bool operator!=(const HybridBitSet &RHS) const { return !(*this == RHS); }
+
+  /// operator|= - Add the elements of RHS. Returns whether the set changed.
+  bool operator|=(const HybridBitSet &RHS) {
+    if (this == &RHS || RHS.empty())
+      return false;
+    if (F == Dense && RHS.F == Dense) {
+      // Stay dense unless the combined span would be too sparse for it. The
+      // union has at least half as many chunks as the two sets together, so
+      // the dense form takes at most twice the memory of the chunked one.
+      size_t Begin = std::min(FirstWord, RHS.FirstWord);
+      size_t End = std::max(FirstWord + Words.size(),
+                            RHS.FirstWord + RHS.Words.size());
+      if (End - Begin == Words.size() ||
+          (End - Begin) * sizeof(uint64_t) <=
+              (getNumDenseChunks() + RHS.getNumDenseChunks()) *
+                  sizeof(Chunk)) {
+        CoverWords(Begin, End);
+        return hybrid_bit_set_detail::OrWords(
+            &Words[RHS.FirstWord - FirstWord], &RHS.Words[0],
+            RHS.Words.size());
+      }
+    }
+
+    std::vector<Chunk> Cs;
+    bool Changed = false;
+    ChunkCursor A(*this), B(RHS);
+    while (!A.done() || !B.done()) {
+      if (B.done() || (!A.done() && A.get().Index < B.get().Index)) {
+        Cs.push_back(A.get());
+        A.next();
+      } else if (A.done() || B.get().Index < A.get().Index) {
+        Cs.push_back(B.get());
+        B.next();
+        Changed = true;
+      } else {
+        Chunk C = A.get();
+        for (unsigned H = 0; H < 2; ++H) {
+          Changed |= (B.get().W[H] & ~C.W[H]) != 0;
+          C.W[H] |= B.get().W[H];
+        }
+        Cs.push_back(C);
+        A.next();
+        B.next();
+      }
+    }
+    if (Changed)
+      SetFromChunks(Cs);
+    return Changed;
+  }
+
+  /// intersectWithComplement - Remove the elements of RHS.
+  void intersectWithComplement(const HybridBitSet &RHS) {
+    intersectWithComplement(*this, RHS);
+  }
+
+  /// intersectWithComplement - Make the set hold the elements of A that are
+  /// not in B. Either may be this set.
+  void intersectWithComplement(const HybridBitSet &A, const HybridBitSet &B) {
+    if (A.F == Dense && B.F == Dense) {
+      HybridBitSet Result;
+      Result.F = Dense;
+      Result.FirstWord = A.FirstWord;
+      Result.Words = A.Words;
+      size_t Begin = std::max(A.FirstWord, B.FirstWord);
+      size_t End = std::min(A.FirstWord + A.Words.size(),
+                            B.FirstWord + B.Words.size());
+      if (Begin < End) {
+        hybrid_bit_set_detail::AndNotWords(
+            &Result.Words[Begin - A.FirstWord],
+            &A.Words[Begin - A.FirstWord], &B.Words[Begin - B.FirstWord],
+            End - Begin);
+      }
+      Result.NormalizeDense();
+      swap(Result);
+      return;
+    }
+
+    std::vector<Chunk> Cs;
+    ChunkCursor X(A), Y(B);
+    for (; !X.done(); X.next()) {
+      while (!Y.done() && Y.get().Index < X.get().Index)
+        Y.next();
+      Chunk C = X.get();
+      if (!Y.done() && Y.get().Index == C.Index) {
+        C.W[0] &= ~Y.get().W[0];
+        C.W[1] &= ~Y.get().W[1];
+      }
+      if (C.W[0] || C.W[1])
+        Cs.push_back(C);
+    }
+    SetFromChunks(Cs);
+  }
+
+  /// intersects - Return whether the two sets share an element.
+  bool intersects(const HybridBitSet &RHS) const {
+    return intersectsIgnoring(RHS, ~0U);
+  }
+
+  /// intersectsIgnoring - Return whether the two sets share an element other
+  /// than Ignoring. Neither set is modified.
+  bool intersectsIgnoring(const HybridBitSet &RHS, unsigned Ignoring) const {
+    if (F == Array || RHS.F == Array) {
+      const HybridBitSet &Small = (F == Array ? *this : RHS);
+      const HybridBitSet &Other = (F == Array ? RHS : *this);
+      for (size_t I = 0; I < Small.Elements.size(); ++I) {
+        if (Small.Elements[I] != Ignoring && Other.test(Small.Elements[I]))
+          return true;
+      }
+      return false;
+    }
+
+    if (F == Dense && RHS.F == Dense) {
+      size_t Begin = std::max(FirstWord, RHS.FirstWord);
+      size_t End = std::min(FirstWord + Words.size(),
+                            RHS.FirstWord + RHS.Words.size());
+      if (Begin >= End)
+        return false;
+      // Test the word holding Ignoring by hand, and the words on either side
+      // of it with the kernel.
+      size_t Skip = Ignoring / 64;
+      if (Skip < Begin || Skip >= End)
+        return IntersectRange(RHS, Begin, End);
+      uint64_t Common = Words[Skip - FirstWord] & RHS.Words[Skip - RHS.FirstWord];
+      Common &= ~((uint64_t)1 << (Ignoring % 64));
+      return Common || IntersectRange(RHS, Begin, Skip) ||
+          IntersectRange(RHS, Skip + 1, End);
+    }
+
+    ChunkCursor A(*this), B(RHS);
+    while (!A.done() && !B.done()) {
+      if (A.get().Index < B.get().Index) {
+        A.next();
+      } else if (B.get().Index < A.get().Index) {
+        B.next();
+      } else {
+        for (unsigned H = 0; H < 2; ++H) {
+          uint64_t Common = A.get().W[H] & B.get().W[H];
+          if (Ignoring / 128 == A.get().Index && Ignoring / 64 % 2 == H)
+            Common &= ~((uint64_t)1 << (Ignoring % 64));
+          if (Common)
+            return true;
+        }
+        A.next();
+        B.next();
+      }
+    }
+    return false;
+  }
+
+  void swap(HybridBitSet &RHS) {
+    std::swap(F, RHS.F);
+    Elements.swap(RHS.Elements);
+    Chunks.swap(RHS.Chunks);
+    Words.swap(RHS.Words);
+    std::swap(FirstWord, RHS.FirstWord);
+  }
+
+ private:
+  struct Chunk {
+    // Elements [Index * 128, Index * 128 + 128).
+    unsigned Index;
+    uint64_t W[2];
+  };
+
+  struct ChunkIndexLess {
+    bool operator()(const Chunk &C, unsigned Index) const {
+      return C.Index < Index;
+    }
+  };
+
+  /// ChunkCursor - Walks the non-empty chunks of a set of any form in
+  /// ascending order.
+  class ChunkCursor {
+    const HybridBitSet &S;
+    size_t Pos;
+    Chunk Current;
+    bool Done;
+
+    void load() {
+      Done = true;
+      switch (S.F) {
+        case Array:
+          if (Pos < S.Elements.size()) {
+            Current.Index = S.Elements[Pos] / 128;
+            Current.W[0] = Current.W[1] = 0;
+            size_t I = Pos;
+            for (; I < S.Elements.size() &&
+                 S.Elements[I] / 128 == Current.Index; ++I) {
+              Current.W[S.Elements[I] / 64 % 2] |=
+                  (uint64_t)1 << (S.Elements[I] % 64);
+            }
+            Pos = I;
+            Done = false;
+          }
+          break;
+        case Chunked:
+          if (Pos < S.Chunks.size()) {
+            Current = S.Chunks[Pos++];
+            Done = false;
+          }
+          break;
+        case Dense:
+          // Pos is the index of the next chunk to look at.
+          for (; Pos * 2 < S.FirstWord + S.Words.size(); ++Pos) {
+            Current.Index = Pos;
+            Current.W[0] = S.getWord(Pos * 2);
+            Current.W[1] = S.getWord(Pos * 2 + 1);
+            if (Current.W[0] || Current.W[1]) {
+              ++Pos;
+              Done = false;
+              break;
+            }
+          }
+          break;
+      }
+    }
+
+   public:
+    explicit ChunkCursor(const HybridBitSet &Set): S(Set), Pos(0), Done(true) {
+      if (S.F == Dense)
+        Pos = S.FirstWord / 2;
+      load();
+    }
+    bool done() const { return Done; }
+    const Chunk &get() const { return Current; }
+    void next() { load(); }
+  };
+
+  uint64_t getWord(size_t I) const {
+    if (I < FirstWord || I - FirstWord >= Words.size())
+      return 0;
+    return Words[I - FirstWord];
+  }
+
+  /// getNumWords, getWordAt - Index the words of a chunked or dense set in
+  /// ascending order. Base is set to the element of bit 0 of the word.
+  size_t getNumWords() const {
+    return F == Chunked ? Chunks.size() * 2 : Words.size();
+  }
+  uint64_t getWordAt(size_t Pos, unsigned &Base) const {
+    if (F == Chunked) {
+      Base = Chunks[Pos / 2].Index * 128 + Pos % 2 * 64;
+      return Chunks[Pos / 2].W[Pos % 2];
+    }
+    Base = (FirstWord + Pos) * 64;
+    return Words[Pos];
+  }
+
+  /// getNumDenseChunks - Return the number of non-empty chunks of a dense
+  /// set, which is what the chunked form would store.
+  size_t getNumDenseChunks() const {
+    size_t Count = 0;
+    if (Words.empty())
+      return 0;
+    for (size_t I = FirstWord / 2; I * 2 < FirstWord + Words.size(); ++I) {
+      if (getWord(I * 2) || getWord(I * 2 + 1))
+        ++Count;
+    }
+    return Count;
+  }
+
+  static bool SetBit(uint64_t &W, unsigned X) {
+    uint64_t Bit = (uint64_t)1 << (X % 64);
+    if (W & Bit)
+      return false;
+    W |= Bit;
+    return true;
+  }
+
+  bool IntersectRange(const HybridBitSet &RHS, size_t Begin,
+                      size_t End) const {
+    if (Begin >= End)
+      return false;
+    return hybrid_bit_set_detail::IntersectWords(
+        &Words[Begin - FirstWord], &RHS.Words[Begin - RHS.FirstWord],
+        End - Begin);
+  }
+
+  /// CoverWords - Grow a dense set to cover words [Begin, End).
+  void CoverWords(size_t Begin, size_t End) {
+    size_t OldEnd = FirstWord + Words.size();
+    if (Begin < FirstWord) {
+      Words.insert(Words.begin(), FirstWord - Begin, 0);
+      FirstWord = Begin;
+    }
+    if (End > OldEnd)
+      Words.resize(End - FirstWord, 0);
+  }
+
+  static void AppendToChunks(std::vector<Chunk> &Cs, unsigned X) {
+    if (Cs.empty() || Cs.back().Index != X / 128) {
+      Chunk C;
+      C.Index = X / 128;
+      C.W[0] = C.W[1] = 0;
+      Cs.push_back(C);
+    }
+    Cs.back().W[X / 64 % 2] |= (uint64_t)1 << (X % 64);
+  }
+
+  /// SetFromChunks - Make the set hold the elements of Cs, which are sorted
+  /// and not empty, in the form that fits them best.
+  void SetFromChunks(const std::vector<Chunk> &Cs) {
+    unsigned Count = 0;
+    for (size_t I = 0; I < Cs.size(); ++I)
+      Count += __builtin_popcountll(Cs[I].W[0]) +
+          __builtin_popcountll(Cs[I].W[1]);
+
+    HybridBitSet Result;
+    if (Count <= ArrayLimit) {
+      Result.F = Array;
+      for (size_t I = 0; I < Cs.size(); ++I) {
+        for (unsigned H = 0; H < 2; ++H) {
+          for (uint64_t W = Cs[I].W[H]; W; W &= W - 1)
+            Result.Elements.push_back(Cs[I].Index * 128 + H * 64 +
+                                      __builtin_ctzll(W));
+        }
+      }
+    } else {
+      size_t SpanWords = (Cs.back().Index - Cs.front().Index + 1) * 2;
+      if (SpanWords * sizeof(uint64_t) <= Cs.size() * sizeof(Chunk)) {
+        Result.F = Dense;
+        Result.FirstWord = Cs.front().Index * 2;
+        Result.Words.assign(SpanWords, 0);
+        for (size_t I = 0; I < Cs.size(); ++I) {
+          Result.Words[Cs[I].Index * 2 - Result.FirstWord] = Cs[I].W[0];
+          Result.Words[Cs[I].Index * 2 + 1 - Result.FirstWord] = Cs[I].W[1];
+        }
+      } else {
+        Result.F = Chunked;
+        Result.Chunks = Cs;
+      }
+    }
+    swap(Result);
+  }
+
+  /// NormalizeDense - Trim the zero words off a dense set, and turn it into
+  /// another form if it got small or sparse.
+  void NormalizeDense() {
+    size_t Begin = 0, End = Words.size();
+    while (Begin < End && !Words[Begin])
+      ++Begin;
+    while (End > Begin && !Words[End - 1])
+      --End;
+    if (Begin == End) {
+      *this = HybridBitSet();
+      return;
+    }
+    Words.erase(Words.begin() + End, Words.end());
+    Words.erase(Words.begin(), Words.begin() + Begin);
+    FirstWord += Begin;
+    if (hybrid_bit_set_detail::CountWords(&Words[0], Words.size()) <=
+            ArrayLimit ||
+        Words.size() * sizeof(uint64_t) > getNumDenseChunks() * sizeof(Chunk)) {
+      std::vector<Chunk> Cs;
+      ChunkCursor C(*this);
+      for (; !C.done(); C.next())
+        Cs.push_back(C.get());
+      SetFromChunks(Cs);
+    }
+  }
+
+  Form F;
+  std::vector<unsigned> Elements;
+  std::vector<Chunk> Chunks;
+  // Bit I of a dense set is bit I % 64 of Words[I / 64 - FirstWord].
+  std::vector<uint64_t> Words;
+  size_t FirstWord;
+};
+}
+
+#endif
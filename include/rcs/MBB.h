@@ -1,6 +1,8 @@
 #ifndef __MBB_H
 #define __MBB_H
 
+#include <vector>
+
 #include "llvm/Module.h"
 #include "llvm/DerivedTypes.h"
 #include "llvm/Instructions.h"
@@ -26,7 +28,7 @@ namespace rcs {
  * MBB1.begin() == %3, MBB1.end() == invoke
  * MBB2.begin() == invoke, MBB2.end() == BB.end()
  */
-struct MicroBasicBlock: public ilist_node<MicroBasicBlock> {
+struct MicroBasicBlock {
   typedef BasicBlock::iterator iterator;
   typedef BasicBlock::const_iterator const_iterator;
 
@@ -61,11 +63,16 @@ struct MicroBasicBlock: public ilist_node<MicroBasicBlock> {
   iterator getFirstNonPHI();
 };
 
+/**
+ * All MBBs of a module are stored in one array in the order of the
+ * module, so the MBBs of a basic block are adjacent and an MBB is
+ * identified by its index in the array. mbb_iterator is a plain pointer into
+ * the array. Pointers stay valid until the pass is rerun. 
+ */
 struct MicroBasicBlockBuilder: public ModulePass {
   static char ID;
 
-  typedef iplist<MicroBasicBlock> MBBListType;
-  typedef DenseMap<BasicBlock*, MBBListType*> mbbmap_t;
+  typedef MicroBasicBlock *iterator;
 
   MicroBasicBlockBuilder();
   virtual void getAnalysisUsage(AnalysisUsage &AU) const { 
@@ -73,18 +80,26 @@ struct MicroBasicBlockBuilder: public ModulePass {
   }
   virtual bool runOnModule(Module &M);
 
-  MBBListType::iterator begin(BasicBlock *bb);
-  MBBListType::iterator end(BasicBlock *bb);
-  MBBListType::iterator parent(const Instruction *ins) {
-    return parent_mbb.lookup(ins);
+  iterator begin(BasicBlock *bb);
+  iterator end(BasicBlock *bb);
+  // Returns NULL if <ins> is not in the module. 
+  iterator parent(const Instruction *ins);
+
+  unsigned getNumMBBs() const { return mbbs.size(); }
+  MicroBasicBlock *getMBB(unsigned id) { return &mbbs[id]; }
+  unsigned getMBBID(const MicroBasicBlock *mbb) const {
+    return mbb - &mbbs[0];
   }
 
  private:
-  mbbmap_t mbbmap;
-  DenseMap<const Instruction *, MicroBasicBlock *> parent_mbb;
+  std::vector<MicroBasicBlock> mbbs;
+  // The MBBs of the basic block with ID i are
+  // mbbs[bb_offsets[i], bb_offsets[i + 1]). 
+  DenseMap<const BasicBlock *, unsigned> bb_ids;
+  std::vector<unsigned> bb_offsets;
 };
 
-typedef MicroBasicBlockBuilder::MBBListType::iterator mbb_iterator;
+typedef MicroBasicBlockBuilder::iterator mbb_iterator;
 }
 
 #endif
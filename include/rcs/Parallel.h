@@ -0,0 +1,83 @@
+// A minimal parallel-for on top of pthreads.
+//
+// ParallelFor(NumThreads, N, Body) calls Body(I, ThreadID) for every I in
+// [0, N). Indices are handed out in chunks from a shared counter, so Body
+// must not care which thread runs which index. ThreadID is in
+// [0, NumThreads) and can be used to index per-thread buffers.
+
+#ifndef __RCS_PARALLEL_H
+#define __RCS_PARALLEL_H
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace rcs {
+template <class BodyTy>
+struct ParallelForWorker {
+  BodyTy *Body;
+  size_t N;
+  size_t Grain;
+  volatile size_t *NextChunk;
+  unsigned ThreadID;
+
+  void run() {
+    for (;;) {
+      size_t Chunk = __sync_fetch_and_add(NextChunk, (size_t)1);
+      size_t Begin = Chunk * Grain;
+      if (Begin >= N)
+        return;
+      size_t End = std::min(N, Begin + Grain);
+      for (size_t I = Begin; I < End; ++I)
+        (*Body)(I, ThreadID);
+    }
+  }
+
+  static void *entry(void *Arg) {
+    static_cast<ParallelForWorker *>(Arg)->run();
+    return NULL;
+  }
+};
+
+template <class BodyTy>
+void ParallelFor(unsigned NumThreads, size_t N, BodyTy &Body,
+                 size_t Grain = 64) {
+  if (Grain == 0)
+    Grain = 1;
+  size_t NumChunks = (N + Grain - 1) / Grain;
+  if (NumThreads <= 1 || NumChunks <= 1) {
+    for (size_t I = 0; I < N; ++I)
+      Body(I, 0);
+    return;
+  }
+
+  unsigned NumWorkers = (unsigned)std::min((size_t)NumThreads, NumChunks);
+  volatile size_t NextChunk = 0;
+  std::vector<ParallelForWorker<BodyTy> > Workers(NumWorkers);
+  for (unsigned i = 0; i < NumWorkers; ++i) {
+    Workers[i].Body = &Body;
+    Workers[i].N = N;
+    Workers[i].Grain = Grain;
+    Workers[i].NextChunk = &NextChunk;
+    Workers[i].ThreadID = i;
+  }
+
+  // Worker 0 runs on the calling thread. If a thread fails to start, the
+  // remaining workers simply drain its share of the chunks.
+  std::vector<pthread_t> Threads(NumWorkers);
+  std::vector<bool> Started(NumWorkers, false);
+  for (unsigned i = 1; i < NumWorkers; ++i) {
+    Started[i] = (pthread_create(&Threads[i], NULL,
+                                 ParallelForWorker<BodyTy>::entry,
+                                 &Workers[i]) == 0);
+  }
+  Workers[0].run();
+  for (unsigned i = 1; i < NumWorkers; ++i) {
+    if (Started[i])
+      pthread_join(Threads[i], NULL);
+  }
+}
+}
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef __RCS_POINTER_ANALYSIS_H
 #define __RCS_POINTER_ANALYSIS_H
 
+#include <string>
+#include <vector>
+
 #include "llvm/Value.h"
+#include "llvm/ADT/ArrayRef.h"
 
 #include "rcs/typedefs.h"
 #include "rcs/IDAssigner.h"
@@ -19,11 +23,36 @@ struct PointerAnalysis {
   virtual bool getPointees(const llvm::Value *Pointer,
                            rcs::ValueList &Pointees) = 0;
   virtual void getAllPointers(rcs::ValueList &Pointers) = 0;
+  // Same as getPointees, but returns a view of the pointees instead of a
+  // copy. Implementations that store the pointees of each pointer
+  // contiguously return a view into that storage, which stays valid as long
+  // as the analysis does. The default implementation goes through
+  // getPointees and a buffer that the next call overwrites. 
+  virtual bool getPointeeRange(const llvm::Value *Pointer,
+                               llvm::ArrayRef<llvm::Value *> &Pointees);
+  // Returns true if getPointeeRange only reads the results of the analysis,
+  // so that several threads may call it at once.
+  virtual bool isThreadSafe() { return false; }
+  // Exports the whole point-to relation in CSR form. The pointees of the
+  // value with ID i are the values with IDs
+  // PointeeIDs[Offsets[i], Offsets[i + 1]). 
+  void exportPointsTo(rcs::IDAssigner &IDA,
+                      std::vector<unsigned> &Offsets,
+                      std::vector<unsigned> &PointeeIDs);
   // Print some stat information to <O>. 
   void printStats(raw_ostream &O);
 
  protected:
-  PointerAnalysis() {}
+  PointerAnalysis();
+  // Returns true if <V> calls one of the memory allocators in MallocNames.
+  bool isMallocCall(const llvm::Value *V) const;
+  bool isMalloc(const llvm::Function *F) const;
+
+  std::vector<std::string> MallocNames;
+
+ private:
+  // Used by the default getPointeeRange. 
+  rcs::ValueList PointeeBuffer;
 };
 }
 
@@ -2,10 +2,13 @@
 #include "llvm/Function.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
 #include "rcs/IDAssigner.h"
+#include "rcs/Parallel.h"
 using namespace rcs;
 
 namespace rcs {
@@ -18,6 +21,35 @@ struct AATester: public ModulePass {
 
  private:
   static void PrintValue(raw_ostream &O, const Value *V);
+  void RunStressTest(IDAssigner &IDA, AliasAnalysis &AA);
+};
+
+// Runs query I of the stress test, and counts the answers that differ from
+// the serial ones.
+struct StressBody {
+  AliasAnalysis *AA;
+  const std::vector<const Value *> *Pointers;
+  const std::vector<unsigned char> *Expected;
+  volatile unsigned Mismatches;
+
+  static uint64_t Mix(uint64_t X) {
+    // splitmix64
+    X += 0x9e3779b97f4a7c15ULL;
+    X = (X ^ (X >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    X = (X ^ (X >> 27)) * 0x94d049bb133111ebULL;
+    return X ^ (X >> 31);
+  }
+
+  AliasAnalysis::AliasResult query(size_t I) const {
+    uint64_t R = Mix(I);
+    size_t N = Pointers->size();
+    return AA->alias((*Pointers)[R % N], (*Pointers)[(R >> 32) % N]);
+  }
+
+  void operator()(size_t I, unsigned ThreadID) {
+    if (query(I) != (*Expected)[I])
+      __sync_fetch_and_add(&Mismatches, 1U);
+  }
 };
 }
 
@@ -33,6 +65,16 @@ static cl::opt<unsigned> ID1("id1", cl::desc("the first ID"),
                              cl::init(IDAssigner::InvalidID));
 static cl::opt<unsigned> ID2("id2", cl::desc("the second ID"),
                              cl::init(IDAssigner::InvalidID));
+static cl::opt<unsigned> StressThreads(
+    "stress-threads",
+    cl::desc("Run -stress-queries alias queries on random pairs of pointers "
+             "from this many threads, and check them against the answers "
+             "of a serial run. 0 runs the single query on -id1 and -id2"),
+    cl::init(0));
+static cl::opt<unsigned> StressQueries(
+    "stress-queries",
+    cl::desc("Number of queries run by -stress-threads"),
+    cl::init(4000000));
 
 char AATester::ID = 0;
 
@@ -46,6 +88,11 @@ bool AATester::runOnModule(Module &M) {
   IDAssigner &IDA = getAnalysis<IDAssigner>();
   AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
 
+  if (StressThreads > 0) {
+    RunStressTest(IDA, AA);
+    return false;
+  }
+
   const Value *V1 = NULL, *V2 = NULL;
   if (ValueID) {
     V1 = IDA.getValue(ID1);
@@ -76,6 +123,46 @@ bool AATester::runOnModule(Module &M) {
   return false;
 }
 
+// The alias analysis must allow concurrent queries, e.g. anders-aa with its
+// solution frozen (the default) chained to no-aa.
+void AATester::RunStressTest(IDAssigner &IDA, AliasAnalysis &AA) {
+  std::vector<const Value *> Pointers;
+  for (unsigned i = 0; i < IDA.getNumValues(); ++i) {
+    const Value *V = IDA.getValue(i);
+    if (V && V->getType()->isPointerTy())
+      Pointers.push_back(V);
+  }
+  if (Pointers.empty()) {
+    errs() << "No pointers to query\n";
+    return;
+  }
+
+  std::vector<unsigned char> Expected(StressQueries);
+  StressBody Body;
+  Body.AA = &AA;
+  Body.Pointers = &Pointers;
+  Body.Expected = &Expected;
+  Body.Mismatches = 0;
+
+  TimeRecord Start = TimeRecord::getCurrentTime(true);
+  for (unsigned i = 0; i < StressQueries; ++i)
+    Expected[i] = Body.query(i);
+  TimeRecord Middle = TimeRecord::getCurrentTime(false);
+  ParallelFor(StressThreads, StressQueries, Body, 4096);
+  TimeRecord End = TimeRecord::getCurrentTime(false);
+
+  double Serial = Middle.getWallTime() - Start.getWallTime();
+  double Parallel = End.getWallTime() - Middle.getWallTime();
+  errs() << Pointers.size() << " pointers, " << StressQueries
+      << " queries\n";
+  errs() << format("serial:     %.3f s\n", Serial);
+  errs() << format("%2u threads: %.3f s\n", (unsigned)StressThreads, Parallel);
+  if (Body.Mismatches)
+    errs() << "FAILED: " << Body.Mismatches << " answers differ\n";
+  else
+    errs() << "All answers match\n";
+}
+
 void AATester::PrintValue(raw_ostream &O, const Value *V) {
   if (isa<Function>(V)) {
     O << V->getName();
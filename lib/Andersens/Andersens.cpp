@@ -60,22 +60,44 @@
 #include "llvm/Instructions.h"
 #include "llvm/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/InstVisitor.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadLocal.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/system_error.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SparseBitVector.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/IntrinsicInst.h"
 
+#include "rcs/AnalysisOptions.h"
+#include "rcs/FNVHashStream.h"
+#include "rcs/HybridBitSet.h"
+#include "rcs/IDAssigner.h"
+#include "rcs/Parallel.h"
+#include "rcs/PointerAnalysis.h"
 #include "rcs/Version.h"
 
+#include <sys/resource.h>
+
 #include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
 #include <set>
 #include <list>
 #include <map>
@@ -91,10 +113,113 @@
 
 using namespace llvm;
 STATISTIC(NumIters      , "Number of iterations to reach convergence");
+STATISTIC(NumNodeVisits, "Number of nodes taken off the work list");
 STATISTIC(NumConstraints, "Number of constraints");
 STATISTIC(NumNodes      , "Number of nodes");
 STATISTIC(NumUnified    , "Number of variables unified");
 STATISTIC(NumErased     , "Number of redundant constraints erased");
+STATISTIC(NumPointsToSets, "Number of distinct points-to sets");
+STATISTIC(NumDemandQueries, "Number of demand-driven queries");
+STATISTIC(NumDemandCacheHits, "Number of demand-driven queries answered "
+                              "by earlier ones");
+STATISTIC(NumDemandGiveUps, "Number of demand-driven queries over budget");
+STATISTIC(NumDemandKnownGiveUps, "Number of demand-driven queries known to "
+                                 "be over budget from earlier ones");
+STATISTIC(NumAliasCacheHits, "Number of alias queries answered from the cache "
+                             "before freezing");
+STATISTIC(NumAliasCacheMisses, "Number of alias queries missing the cache "
+                               "before freezing");
+STATISTIC(NumIncrementalReset, "Number of nodes reset by incremental solving");
+
+namespace {
+  /// WorkListKind - The order in which the serial solver visits nodes.
+  enum WorkListKind { LRF, FIFO, LIFO, Topo };
+  /// RenumberKind - How ClumpAddressTaken orders the nodes that are not
+  /// address taken.
+  enum RenumberKind { NoRenumber, BFSRenumber, RPORenumber };
+}
+
+static cl::opt<WorkListKind> AndersWorkList(
+    "anders-worklist",
+    cl::desc("Work list used by the serial solver"),
+    cl::values(clEnumValN(LRF, "lrf", "Least recently fired first (default)"),
+               clEnumValN(FIFO, "fifo", "First in, first out"),
+               clEnumValN(LIFO, "lifo", "Last in, first out"),
+               clEnumValN(Topo, "topo", "Topological order of the "
+                          "constraint graph, recomputed every iteration"),
+               clEnumValEnd),
+    cl::init(LRF));
+static cl::opt<RenumberKind> Renumber(
+    "anders-renumber",
+    cl::desc("Order of the nodes that are not address taken"),
+    cl::values(clEnumValN(NoRenumber, "none",
+                          "Order of creation (default)"),
+               clEnumValN(BFSRenumber, "bfs",
+                          "Breadth-first over the copy constraints"),
+               clEnumValN(RPORenumber, "rpo",
+                          "Reverse post-order of the copy constraints"),
+               clEnumValEnd),
+    cl::init(NoRenumber));
+static cl::opt<bool> BenchmarkWorkLists(
+    "anders-worklist-benchmark",
+    cl::desc("Solve the constraints with every work list and report the "
+             "iterations, node visits and wall time of each"),
+    cl::init(false));
+static cl::opt<bool> BenchmarkBitSets(
+    "anders-bitset-benchmark",
+    cl::desc("Time unions, differences and intersection tests of the solved "
+             "points-to sets as SparseBitVectors and as HybridBitSets"),
+    cl::init(false));
+static cl::opt<unsigned> AndersThreads("anders-threads",
+                                       cl::desc("Number of threads used to "
+                                                "collect and solve the "
+                                                "constraints. 1 uses the "
+                                                "serial solver"),
+                                       cl::init(1));
+static cl::opt<std::string> IncrementalState("anders-incremental-state",
+                                             cl::desc("File that keeps the "
+                                                      "constraints and the "
+                                                      "solution between runs "
+                                                      "for incremental "
+                                                      "solving"));
+static cl::opt<unsigned> IncrementalResetLimit(
+    "anders-incremental-reset-limit",
+    cl::desc("Solve from scratch if incremental solving would reset more "
+             "than this percentage of the nodes"),
+    cl::init(30));
+static cl::opt<bool> DemandDriven("anders-demand",
+                                  cl::desc("Compute points-to sets when they "
+                                           "are queried instead of solving "
+                                           "all constraints up front"),
+                                  cl::init(false));
+static cl::opt<unsigned> DemandBudget(
+    "anders-demand-budget",
+    cl::desc("Number of constraint evaluations after which a demand-driven "
+             "query gives up. 0 means no limit"),
+    cl::init(1000000));
+static cl::opt<unsigned> AliasCacheSize(
+    "anders-alias-cache-size",
+    cl::desc("Number of slots in the cache of alias results between "
+             "representatives, rounded up to a power of two. 0 disables the "
+             "cache"),
+    cl::init(1 << 20));
+static cl::opt<std::string> StatsJSON(
+    "anders-stats-json",
+    cl::desc("Write the time, memory and graph size of each phase, and the "
+             "progress of each solver iteration, to this JSON file"));
+static cl::opt<std::string> SnapshotOut("anders-snapshot-out",
+                                        cl::desc("Save the solved points-to "
+                                                 "graph to this file"));
+static cl::opt<std::string> SnapshotIn("anders-snapshot-in",
+                                       cl::desc("Answer queries from the "
+                                                "points-to graph saved in "
+                                                "this file instead of "
+                                                "solving"));
+static cl::opt<bool> FreezeSolution(
+    "anders-freeze",
+    cl::desc("After solving, flatten the points-to sets into read-only "
+             "arrays and free the solver's graph"),
+    cl::init(true));
 
 static const unsigned SelfRep = (unsigned)-1;
 static const unsigned Unvisited = (unsigned)-1;
@@ -103,23 +228,30 @@ static const unsigned CallReturnPos = 1;
 // Position of the function call node relative to the function node.
 static const unsigned CallFirstArgPos = 2;
 
+// Hash the elements of a bitmap.  Equal sets hash the same whatever their
+// forms.
+static unsigned HashBitmap(const rcs::HybridBitSet &Bitmap) {
+  unsigned Hash = 2166136261U;
+  for (rcs::HybridBitSet::iterator I = Bitmap.begin(), E = Bitmap.end();
+       I != E; ++I) {
+    Hash = (Hash ^ *I) * 16777619U;
+  }
+  return Hash;
+}
+
 namespace {
 struct BitmapKeyInfo {
-  static inline SparseBitVector<> *getEmptyKey() {
-    return reinterpret_cast<SparseBitVector<> *>(-1);
+  static inline rcs::HybridBitSet *getEmptyKey() {
+    return reinterpret_cast<rcs::HybridBitSet *>(-1);
   }
-  static inline SparseBitVector<> *getTombstoneKey() {
-    return reinterpret_cast<SparseBitVector<> *>(-2);
+  static inline rcs::HybridBitSet *getTombstoneKey() {
+    return reinterpret_cast<rcs::HybridBitSet *>(-2);
   }
-  static unsigned getHashValue(const SparseBitVector<> *bitmap) {
-#if LLVM_VERSION_CODE < LLVM_VERSION(3, 1)
-    return bitmap->getHashValue();
-#else
-    return 0;
-#endif
+  static unsigned getHashValue(const rcs::HybridBitSet *bitmap) {
+    return HashBitmap(*bitmap);
   }
-  static bool isEqual(const SparseBitVector<> *LHS,
-                      const SparseBitVector<> *RHS) {
+  static bool isEqual(const rcs::HybridBitSet *LHS,
+                      const rcs::HybridBitSet *RHS) {
     if (LHS == RHS)
       return true;
     else if (LHS == getEmptyKey() || RHS == getEmptyKey()
@@ -132,9 +264,208 @@ struct BitmapKeyInfo {
   static bool isPod() { return true; }
 };
 
+/// PointsToSetStore - Hash-conses points-to sets.  Identical sets are stored
+/// once and referred to by a small ID, with ID 0 being the empty set.  Sets
+/// are reference counted and never modified once interned.
+///
+/// The store is split into shards, one per solver thread, so that threads
+/// intern and free sets without locking.  A set is only looked up in the
+/// shard of the thread interning it, so threads may keep duplicates of each
+/// other's sets.  The low ShardBits bits of an ID name its shard.
+class PointsToSetStore {
+ public:
+  typedef unsigned SetID;
+  static const SetID EmptySet = 0;
+  static const unsigned ShardBits = 6;
+  static const unsigned NumShards = 1 << ShardBits;
+
+  PointsToSetStore(): Shards(NumShards) {
+    EmptyBitmap = new rcs::HybridBitSet;
+    Shards[0].Bitmaps[0] = EmptyBitmap;
+  }
+
+  ~PointsToSetStore() {
+    clear();
+    delete EmptyBitmap;
+  }
+
+  /// intern - Return the ID of the set equal to B, storing a copy of B in
+  /// shard S if it has none yet.  The caller owns one reference to the ID.
+  /// If Canonical is given, it is set to the stored set.  Threads interning
+  /// into different shards may run at once.
+  SetID intern(const rcs::HybridBitSet &B, unsigned S = 0,
+               const rcs::HybridBitSet **Canonical = NULL) {
+    if (B.empty()) {
+      if (Canonical)
+        *Canonical = EmptyBitmap;
+      return EmptySet;
+    }
+
+    Shard &Sh = Shards[S];
+    unsigned Hash = HashBitmap(B);
+    unsigned Key = Hash & BucketKeyMask;
+    unsigned Index = 0;
+    DenseMap<unsigned, unsigned>::iterator Bucket = Sh.Buckets.find(Key);
+    if (Bucket != Sh.Buckets.end()) {
+      for (unsigned I = Bucket->second; I != 0; I = Sh.NextInBucket[I]) {
+        if (Sh.Hashes[I] == Hash && *Sh.Bitmaps[I] == B) {
+          Index = I;
+          break;
+        }
+      }
+    }
+    if (Index != 0) {
+      ++Sh.RefCounts[Index];
+    } else {
+      if (!Sh.FreeIndices.empty()) {
+        Index = Sh.FreeIndices.back();
+        Sh.FreeIndices.pop_back();
+        Sh.Bitmaps[Index] = new rcs::HybridBitSet(B);
+        Sh.Hashes[Index] = Hash;
+        Sh.RefCounts[Index] = 1;
+      } else {
+        Index = Sh.Bitmaps.size();
+        Sh.Bitmaps.push_back(new rcs::HybridBitSet(B));
+        Sh.Hashes.push_back(Hash);
+        Sh.RefCounts.push_back(1);
+        Sh.NextInBucket.push_back(0);
+      }
+      Sh.NextInBucket[Index] =
+          (Bucket == Sh.Buckets.end() ? 0 : Bucket->second);
+      Sh.Buckets[Key] = Index;
+    }
+    if (Canonical)
+      *Canonical = Sh.Bitmaps[Index];
+    return Index << ShardBits | S;
+  }
+
+  /// getShard - Return the shard holding the set with the given ID.
+  static unsigned getShard(SetID ID) {
+    return ID & (NumShards - 1);
+  }
+
+  /// release - Drop one reference to ID, freeing the set with the last one.
+  void release(SetID ID) {
+    drop(ID);
+  }
+
+  /// release - Like release(ID), but may be called from the thread of shard
+  /// S while other threads use their shards.  Sets of other shards are only
+  /// queued, and freed by flushReleases.
+  void release(SetID ID, unsigned S) {
+    if (getShard(ID) == S)
+      drop(ID);
+    else
+      Shards[S].Deferred.push_back(ID);
+  }
+
+  /// flushReleases - Free the sets queued by release(ID, S).  No other
+  /// method may run at the same time.
+  void flushReleases() {
+    for (unsigned S = 0; S < NumShards; ++S) {
+      std::vector<SetID> &Deferred = Shards[S].Deferred;
+      for (size_t i = 0; i < Deferred.size(); ++i)
+        drop(Deferred[i]);
+      Deferred.clear();
+    }
+  }
+
+  /// getBitmap - Return the set with the given ID.  It is shared by every
+  /// holder of the ID, and must not be modified.
+  rcs::HybridBitSet *getBitmap(SetID ID) const {
+    const Shard &Sh = Shards[getShard(ID)];
+    assert((ID >> ShardBits) < Sh.Bitmaps.size() &&
+           Sh.Bitmaps[ID >> ShardBits] && "Invalid set ID");
+    return Sh.Bitmaps[ID >> ShardBits];
+  }
+
+  /// intersectsIgnoring - Return true if the two sets share an element
+  /// other than Ignoring.  The sets are not modified, so queries may run at
+  /// once.  Results are cached by Andersens::AliasCache.
+  bool intersectsIgnoring(SetID A, SetID B, unsigned Ignoring) const {
+    if (A == EmptySet || B == EmptySet)
+      return false;
+    return getBitmap(A)->intersectsIgnoring(*getBitmap(B), Ignoring);
+  }
+
+  /// clear - Free every set.  Only the empty set stays valid.
+  void clear() {
+    for (unsigned S = 0; S < NumShards; ++S) {
+      Shard &Sh = Shards[S];
+      for (size_t i = 1; i < Sh.Bitmaps.size(); ++i)
+        delete Sh.Bitmaps[i];
+      Sh = Shard();
+    }
+    Shards[0].Bitmaps[0] = EmptyBitmap;
+  }
+
+  /// getNumSets - Return the number of distinct sets alive, counting the
+  /// copies in different shards separately.
+  unsigned getNumSets() const {
+    unsigned NumSets = 1;
+    for (unsigned S = 0; S < NumShards; ++S)
+      NumSets += Shards[S].Bitmaps.size() - 1 - Shards[S].FreeIndices.size();
+    return NumSets;
+  }
+
+ private:
+  // DenseMap reserves the two largest keys.
+  static const unsigned BucketKeyMask = 0x7fffffff;
+
+  struct Shard {
+    // Sets are indexed from 1, so that no set gets the ID of EmptySet.
+    std::vector<rcs::HybridBitSet *> Bitmaps;
+    std::vector<unsigned> Hashes;
+    std::vector<unsigned> RefCounts;
+    // Sets with the same bucket key are chained through NextInBucket, and the
+    // chain ends with 0.
+    DenseMap<unsigned, unsigned> Buckets;
+    std::vector<unsigned> NextInBucket;
+    std::vector<unsigned> FreeIndices;
+    // Sets of other shards released by this shard's thread.
+    std::vector<SetID> Deferred;
+
+    Shard(): Bitmaps(1, (rcs::HybridBitSet *)NULL), Hashes(1, 0),
+        RefCounts(1, 0), NextInBucket(1, 0) {}
+  };
+
+  /// drop - Drop one reference to ID, freeing the set with the last one.
+  void drop(SetID ID) {
+    if (ID == EmptySet)
+      return;
+    Shard &Sh = Shards[getShard(ID)];
+    unsigned Index = ID >> ShardBits;
+    assert(Sh.RefCounts[Index] > 0 && "Releasing a dead set");
+    if (--Sh.RefCounts[Index] != 0)
+      return;
+
+    unsigned Key = Sh.Hashes[Index] & BucketKeyMask;
+    unsigned &Head = Sh.Buckets[Key];
+    if (Head == Index) {
+      Head = Sh.NextInBucket[Index];
+      if (Head == 0)
+        Sh.Buckets.erase(Key);
+    } else {
+      unsigned Prev = Head;
+      while (Sh.NextInBucket[Prev] != Index)
+        Prev = Sh.NextInBucket[Prev];
+      Sh.NextInBucket[Prev] = Sh.NextInBucket[Index];
+    }
+    delete Sh.Bitmaps[Index];
+    Sh.Bitmaps[Index] = NULL;
+    Sh.FreeIndices.push_back(Index);
+  }
+
+  rcs::HybridBitSet *EmptyBitmap;
+  std::vector<Shard> Shards;
+};
+
+const PointsToSetStore::SetID PointsToSetStore::EmptySet;
+const unsigned PointsToSetStore::NumShards;
 
 class Andersens: public ModulePass,
                  public AliasAnalysis,
+                 public rcs::AnalysisOptions,
                  private InstVisitor<Andersens> {
   struct Node;
 
@@ -191,7 +522,8 @@ class Andersens: public ModulePass,
       return std::make_pair(~0U - 1, ~0U - 1);
     }
     static unsigned getHashValue(const std::pair<unsigned, unsigned> &P) {
-      return P.first ^ P.second;
+      // Plain xor maps every (N, N) to 0 and clusters pairs of nearby nodes.
+      return P.first * 37U ^ P.second * 0x9e3779b9U;
     }
     static unsigned isEqual(const std::pair<unsigned, unsigned> &LHS,
                             const std::pair<unsigned, unsigned> &RHS) {
@@ -226,11 +558,31 @@ class Andersens: public ModulePass,
     static volatile sys::cas_flag Counter;
 
    public:
-    Value *Val;
+    // The fields the solver touches for every node it visits come first, so
+    // that they share a cache line.  The ones only used by the offline
+    // optimizations come last.
+    // While the solver runs, PointsTo is the same object as OldPointsTo until
+    // it changes, and must be written through UnionPointsTo.
+    rcs::HybridBitSet *PointsTo;
+    // The points-to set as of the last time the solver processed this node.
+    // It is interned in SetStore and may be shared with other nodes.
+    const rcs::HybridBitSet *OldPointsTo;
     SparseBitVector<> *Edges;
-    SparseBitVector<> *PointsTo;
-    SparseBitVector<> *OldPointsTo;
+
+    // Nodes in cycles (or in equivalence classes) are united together using a
+    // standard union-find representation with path compression.  NodeRep
+    // gives the index into GraphNodes for the representative Node.
+    unsigned NodeRep;
+
+    // Modification timestamp.  Assigned from Counter.
+    // Used for work list prioritization.
+    unsigned Timestamp;
+
+    unsigned OldPointsToSet;
+    // ID of PointsTo in SetStore, once the solver is done with it.
+    unsigned PointsToSet;
     std::list<Constraint> Constraints;
+    Value *Val;
 
     // Pointer and location equivalence labels
     unsigned PointerEquivLabel;
@@ -253,21 +605,12 @@ class Andersens: public ModulePass,
     // their base function node.
     bool AddressTaken;
 
-    // Nodes in cycles (or in equivalence classes) are united together using a
-    // standard union-find representation with path compression.  NodeRep
-    // gives the index into GraphNodes for the representative Node.
-    unsigned NodeRep;
-
-    // Modification timestamp.  Assigned from Counter.
-    // Used for work list prioritization.
-    unsigned Timestamp;
-
     explicit Node(bool direct = true) :
-        Val(0), Edges(0), PointsTo(0), OldPointsTo(0),
+        PointsTo(0), OldPointsTo(0), Edges(0), NodeRep(SelfRep), Timestamp(0),
+        OldPointsToSet(0), PointsToSet(0), Val(0),
         PointerEquivLabel(0), LocationEquivLabel(0), PredEdges(0),
         ImplicitPredEdges(0), PointedToBy(0), NumInEdges(0),
-        StoredInHash(false), Direct(direct), AddressTaken(false),
-        NodeRep(SelfRep), Timestamp(0) { }
+        StoredInHash(false), Direct(direct), AddressTaken(false) { }
 
     Node *setValue(Value *V) {
       assert(Val == 0 && "Value already set for this node!");
@@ -320,22 +663,22 @@ class Andersens: public ModulePass,
     }
   };
 
-  // Priority-queue based work list specialized for Nodes.
+  // Work list of nodes.  An entry remembers the timestamp of its node when it
+  // was inserted.  We automatically discard non-representative nodes and
+  // nodes that were in the work list twice: the node is stamped when it is
+  // popped, so the stale copies no longer match its timestamp.  Subclasses
+  // only decide the order.
   class WorkList {
-    std::priority_queue<WorkListElement> Q;
-
    public:
+    virtual ~WorkList() {}
+
     void insert(Node* n) {
-      Q.push( WorkListElement(n, n->Timestamp) );
+      push(WorkListElement(n, n->Timestamp));
     }
 
-    // We automatically discard non-representative nodes and nodes
-    // that were in the work list twice (we keep a copy of the
-    // timestamp in the work list so we can detect this situation by
-    // comparing against the node's current timestamp).
     Node* pop() {
-      while( !Q.empty() ) {
-        WorkListElement x = Q.top(); Q.pop();
+      while( !empty() ) {
+        WorkListElement x = next();
         Node* INode = x.node;
 
         if( INode->isRep() &&
@@ -346,8 +689,98 @@ class Andersens: public ModulePass,
       return(0);
     }
 
-    bool empty() {
-      return Q.empty();
+    virtual bool empty() const = 0;
+    // The number of entries, including the ones pop() will discard.
+    virtual size_t size() const = 0;
+
+   protected:
+    virtual void push(const WorkListElement &x) = 0;
+    virtual WorkListElement next() = 0;
+  };
+
+  // Least recently fired first: nodes with the oldest timestamps go first.
+  class LRFWorkList : public WorkList {
+    std::priority_queue<WorkListElement> Q;
+
+   public:
+    bool empty() const { return Q.empty(); }
+    size_t size() const { return Q.size(); }
+
+   protected:
+    void push(const WorkListElement &x) { Q.push(x); }
+    WorkListElement next() {
+      WorkListElement x = Q.top(); Q.pop();
+      return x;
+    }
+  };
+
+  class FIFOWorkList : public WorkList {
+    std::deque<WorkListElement> Q;
+
+   public:
+    bool empty() const { return Q.empty(); }
+    size_t size() const { return Q.size(); }
+
+   protected:
+    void push(const WorkListElement &x) { Q.push_back(x); }
+    WorkListElement next() {
+      WorkListElement x = Q.front(); Q.pop_front();
+      return x;
+    }
+  };
+
+  class LIFOWorkList : public WorkList {
+    std::vector<WorkListElement> Q;
+
+   public:
+    bool empty() const { return Q.empty(); }
+    size_t size() const { return Q.size(); }
+
+   protected:
+    void push(const WorkListElement &x) { Q.push_back(x); }
+    WorkListElement next() {
+      WorkListElement x = Q.back(); Q.pop_back();
+      return x;
+    }
+  };
+
+  // Visits nodes in the order given by Order, which the solver recomputes
+  // before each iteration.  The solver never inserts into the list it is
+  // draining, so the entries are sorted once, on the first pop.
+  class TopoWorkList : public WorkList {
+    struct Later {
+      const std::vector<unsigned> &Order;
+      const Node *Base;
+      Later(const std::vector<unsigned> &O, const Node *B): Order(O), Base(B) {}
+      bool operator()(const WorkListElement &A,
+                      const WorkListElement &B) const {
+        return Order[A.node - Base] > Order[B.node - Base];
+      }
+    };
+
+    std::vector<WorkListElement> Q;
+    bool Sorted;
+    const std::vector<unsigned> &Order;
+    const Node *Base;
+
+   public:
+    TopoWorkList(const std::vector<unsigned> &O, const Node *B):
+        Sorted(true), Order(O), Base(B) {}
+    bool empty() const { return Q.empty(); }
+    size_t size() const { return Q.size(); }
+
+   protected:
+    void push(const WorkListElement &x) {
+      Q.push_back(x);
+      Sorted = false;
+    }
+    WorkListElement next() {
+      if (!Sorted) {
+        std::sort(Q.begin(), Q.end(), Later(Order, Base));
+        Sorted = true;
+      }
+      WorkListElement x = Q.back(); Q.pop_back();
+      return x;
     }
   };
 
@@ -356,6 +789,9 @@ class Andersens: public ModulePass,
   /// node for each memory object and fills in the ValueNodes map.
   std::vector<Node> GraphNodes;
 
+  /// SetStore - Interned points-to sets, shared among the nodes.
+  PointsToSetStore SetStore;
+
   /// ValueNodes - This map indicates the Node that a particular Value* is
   /// represented by.  This contains entries for all pointers.
   DenseMap<Value*, unsigned> ValueNodes;
@@ -408,9 +844,187 @@ class Andersens: public ModulePass,
   // Current DFS number
   unsigned DFSNumber;
 
+  /// SolvedGraph - The solution, flattened into read-only arrays that answer
+  /// queries once the solver's graph is freed, and that can be saved and
+  /// mapped back in as is.  Sets are sorted and shared by all nodes with the
+  /// same points-to set.
+  struct SolvedGraph {
+    enum {
+      // The node is an object that cannot be modified.
+      ConstantMemory = 1,
+      // The node is the object of its value (in ObjectNodes).
+      Object = 2
+    };
+
+    unsigned NumValues, NumNodes, NumSets, NumElements;
+    // IDAssigner value ID -> representative node, or ~0U.
+    const uint32_t *ValueNodes;
+    // Node -> IDAssigner value ID of its value, or ~0U.
+    const uint32_t *NodeValues;
+    const uint32_t *NodeFlags;
+    const uint32_t *Reps;
+    // Node -> its set.  The elements of set S are
+    // Elements[SetBegin[S], SetBegin[S + 1]).
+    const uint32_t *NodeSets;
+    const uint32_t *SetBegin;
+    const uint32_t *Elements;
+
+    SolvedGraph(): NumValues(0), NumNodes(0), NumSets(0), NumElements(0) {}
+
+    /// getNumWords - Return the total length of the arrays.
+    uint64_t getNumWords() const {
+      return (uint64_t)NumValues + 4 * (uint64_t)NumNodes + NumSets + 1 +
+          NumElements;
+    }
+    void map(const uint32_t *P);
+    bool isValid() const;
+
+    const uint32_t *begin(unsigned N) const {
+      return Elements + SetBegin[NodeSets[N]];
+    }
+    const uint32_t *end(unsigned N) const {
+      return Elements + SetBegin[NodeSets[N] + 1];
+    }
+    bool empty(unsigned N) const { return begin(N) == end(N); }
+    bool intersectsIgnoring(unsigned N1, unsigned N2,
+                            unsigned Ignoring) const;
+    bool contains(unsigned N, unsigned Element) const;
+  };
+  // Set by Freeze and LoadSnapshot.  Queries are answered from Solved
+  // instead of GraphNodes when it is, and GraphNodes is gone.
+  bool Frozen;
+  SolvedGraph Solved;
+  // The storage of Solved: the mapped snapshot, or the arrays built by
+  // FlattenSolution.
+  OwningPtr<MemoryBuffer> SnapshotBuffer;
+  std::vector<uint32_t> SolvedArrays;
+  // Node of Solved -> its value.  Empty if Solved is a snapshot, whose
+  // values are found through IDA.
+  std::vector<Value *> SolvedValues;
+  // The objects in each set of Solved, for getPointeeRange: those of set S
+  // are SetPointees[SetPointeesBegin[S], SetPointeesBegin[S + 1]).  Built on
+  // first use.
+  std::vector<Value *> SetPointees;
+  std::vector<unsigned> SetPointeesBegin;
+  // The same before the solution is frozen: the objects in each set of
+  // SetStore, keyed by set ID.  Filled in as queried, and emptied when the
+  // sets change.
+  std::map<unsigned, rcs::ValueList> StorePointees;
+  rcs::IDAssigner *IDA;
+
+  // Demand-driven queries.  If Demand is set, the constraints were not
+  // solved, and a node gets its PointsTo set when it is first queried.
+  bool Demand;
+  // Node -> the Copy, AddressOf and Load constraints into it.
+  std::vector<std::vector<unsigned> > DemandInEdges;
+  std::vector<unsigned> DemandStores;
+  // Node -> the stores, as indices into DemandStores, whose pointer or
+  // source it is.  A store only needs another look when one of them changes.
+  std::vector<std::vector<unsigned> > DemandStoreUsers;
+  // Nodes that stores may write to.
+  SparseBitVector<> DemandStoreTargets;
+  // Nodes whose queries went over -anders-demand-budget.
+  SparseBitVector<> DemandOverBudget;
+  struct DemandQuery;
+  friend struct DemandQuery;
+
+  // Incremental solving.  The constraints collected for each function form
+  // a group; temporaries created for the function are numbered in
+  // [FirstNode, EndNode).
+  struct ConstraintGroup {
+    std::string Name;
+    Function *F;
+    unsigned Begin, End;
+    unsigned FirstNode, EndNode;
+  };
+  std::vector<ConstraintGroup> ConstraintGroups;
+  // Constraints as collected, before the offline optimizations rewrite them.
+  std::vector<Constraint> CollectedConstraints;
+  // Names of the nodes that are stable across runs.
+  std::vector<std::string> NodeKeys;
+  // Where ClumpAddressTaken moved each collected node.
+  std::vector<unsigned> Renumbering;
+
+  // Flattened union-find used by the parallel phases of the wave solver.
+  std::vector<unsigned> WaveRep;
+  struct WavePullBody;
+  struct WaveResolveBody;
+  friend struct WavePullBody;
+  friend struct WaveResolveBody;
+
+  // Instrumentation, filled in if -anders-stats-json is given.
+  struct PhaseRecord {
+    std::string Name;
+    unsigned Depth;
+    double Wall, CPU;
+    long PeakRSSDelta;
+    unsigned Nodes, Edges, Constraints;
+  };
+  struct IterationRecord {
+    const char *Solver;
+    unsigned Iteration, WorkList;
+    std::vector<unsigned> Histogram;
+  };
+  std::vector<PhaseRecord> Phases;
+  std::vector<IterationRecord> Iterations;
+  unsigned PhaseDepth;
+  class PhaseScope;
+  friend class PhaseScope;
+
+  /// ConstraintBuffer - The constraints of one function, collected on a worker
+  /// thread.  Its temporary nodes are numbered from FirstTemp on, past all
+  /// nodes that exist during collection, and are renumbered when the buffer
+  /// is merged.
+  struct ConstraintBuffer {
+    std::vector<Constraint> Constraints;
+    unsigned FirstTemp;
+    unsigned NumTemps;
+    ConstraintBuffer(): FirstTemp(0), NumTemps(0) {}
+  };
+  // The buffer of the function visited on the current thread, if any.
+  sys::ThreadLocal<ConstraintBuffer> CurrentBuffer;
+  struct CollectBody;
+  friend struct CollectBody;
+
+  /// AliasCache - Whether the points-to sets of two representatives share an
+  /// object other than the null object.  A direct-mapped table whose entries
+  /// are single 64-bit words: the valid bit, the answer, and the pair with the
+  /// smaller representative first.  Concurrent queries use no locks: they
+  /// read an entry with a plain aligned load, which x86-64 does atomically,
+  /// and publish one with __sync_bool_compare_and_swap.  A reader checks
+  /// that the entry it sees is for its pair, and a writer only replaces the
+  /// entry it read, so a lost race only costs a miss.  Hits cost no shared
+  /// write.  Cleared when the solution changes.
+  std::vector<uint64_t> AliasCache;
+  static const uint64_t AliasCacheValid = 1ULL << 63;
+  static const uint64_t AliasCacheShares = 1ULL << 62;
+  static const uint64_t AliasCacheKeyMask = (1ULL << 62) - 1;
+
   // Work lists.
-  WorkList w1, w2;
+  OwningPtr<WorkList> w1, w2;
   WorkList *CurrWL, *NextWL; // "current" and "next" work lists
+  // Position of each node in the topological order of the constraint graph.
+  // Only maintained for the topo work list.
+  std::vector<unsigned> TopoOrder;
+  // Progress of the last run of the serial solver.
+  unsigned SolverIterations, SolverVisits;
+
+  // A copy of the solver's graph, so that the same constraints can be solved
+  // more than once.
+  struct SolverState {
+    std::vector<unsigned> NodeReps;
+    std::vector<rcs::HybridBitSet *> PointsTo;
+    std::vector<SparseBitVector<> *> Edges;
+    std::vector<std::list<Constraint> > Constraints;
+    std::vector<int> SDT;
+
+    ~SolverState() {
+      for (unsigned i = 0; i < PointsTo.size(); ++i) {
+        delete PointsTo[i];
+        delete Edges[i];
+      }
+    }
+  };
 
   // Offline variable substitution related things
 
@@ -431,7 +1045,7 @@ class Andersens: public ModulePass,
   // Current pointer equivalence class number
   unsigned PEClass;
   // Mapping from points-to sets to equivalence classes
-  typedef DenseMap<SparseBitVector<> *, unsigned, BitmapKeyInfo> BitVectorMap;
+  typedef DenseMap<rcs::HybridBitSet *, unsigned, BitmapKeyInfo> BitVectorMap;
   BitVectorMap Set2PEClass;
   // Mapping from pointer equivalences to the representative node.  -1 if we
   // have no representative node for this pointer equivalence class yet.
@@ -450,14 +1064,29 @@ class Andersens: public ModulePass,
 
  public:
   static char ID;
-  Andersens() : ModulePass(ID) {}
+  Andersens()
+      : ModulePass(ID), Frozen(false), IDA(NULL), Demand(false),
+        PhaseDepth(0) {}
 
   virtual void *getAdjustedAnalysisPointer(AnalysisID PI) {
     if (PI == &AliasAnalysis::ID)
       return (AliasAnalysis *)this;
+    if (PI == &rcs::AnalysisOptions::ID)
+      return (rcs::AnalysisOptions *)this;
     return this;
   }
 
+  /// printOptions - Print the options that decide which points-to sets are
+  /// solved and where they come from.  The others only change how fast.
+  virtual void printOptions(raw_ostream &O) const {
+    O << "anders-demand=" << (DemandDriven ? 1 : 0)
+      << " anders-demand-budget=" << (unsigned)DemandBudget
+      << " anders-snapshot-in=" << SnapshotIn
+      << " anders-incremental-state=" << IncrementalState
+      << " anders-incremental-reset-limit="
+      << (unsigned)IncrementalResetLimit;
+  }
+
   static bool isMallocCall(const Value *V) {
     const CallInst *CI = dyn_cast<CallInst>(V);
     if (!CI)
@@ -484,6 +1113,17 @@ class Andersens: public ModulePass,
 
   bool runOnModule(Module &M) {
     InitializeAliasAnalysis(this);
+    ClearAliasCache();
+    if (!SnapshotIn.empty() || !SnapshotOut.empty())
+      IDA = &getAnalysis<rcs::IDAssigner>();
+    if (!SnapshotIn.empty()) {
+      if (LoadSnapshot(M)) {
+        WriteStatsJSON();
+        return false;
+      }
+      errs() << "Solving from scratch\n";
+    }
+
     IdentifyObjects(M);
     CollectConstraints(M);
 #undef DEBUG_TYPE
@@ -491,16 +1131,47 @@ class Andersens: public ModulePass,
     DEBUG(PrintConstraints());
 #undef DEBUG_TYPE
 #define DEBUG_TYPE "anders-aa"
-    SolveConstraints();
+    if (DemandDriven) {
+      if (IncrementalState.empty() && SnapshotOut.empty()) {
+        // Keep the constraints for the queries.
+        BuildDemandIndex();
+        WriteStatsJSON();
+        return false;
+      }
+      errs() << "Ignoring -anders-demand: incremental solving and snapshots "
+          "need the whole solution\n";
+    }
+    if (IncrementalState.empty()) {
+      SolveConstraints();
+    } else {
+      ComputeNodeKeys(M);
+      CollectedConstraints = Constraints;
+      if (!SolveIncrementally())
+        SolveConstraints();
+      WriteIncrementalState();
+      std::vector<std::string>().swap(NodeKeys);
+      std::vector<Constraint>().swap(CollectedConstraints);
+      std::vector<ConstraintGroup>().swap(ConstraintGroups);
+      std::vector<unsigned>().swap(Renumbering);
+    }
     DEBUG(PrintPointsToGraph());
-
-    // Free the constraints list, as we don't need it to respond to alias
-    // requests.
-    std::vector<Constraint>().swap(Constraints);
-    //These are needed for Print() (-analyze in opt)
-    //ObjectNodes.clear();
-    //ReturnNodes.clear();
-    //VarargNodes.clear();
+    if (BenchmarkBitSets)
+      RunBitSetBenchmark();
+    if (FreezeSolution || !SnapshotOut.empty())
+      FlattenSolution();
+    if (!SnapshotOut.empty())
+      WriteSnapshot(M);
+    if (FreezeSolution) {
+      Freeze();
+    } else {
+      std::vector<uint32_t>().swap(SolvedArrays);
+      std::vector<Value *>().swap(SolvedValues);
+      Solved = SolvedGraph();
+      // Free the constraints list, as we don't need it to respond to alias
+      // requests.
+      std::vector<Constraint>().swap(Constraints);
+    }
+    WriteStatsJSON();
     return false;
   }
 
@@ -519,6 +1190,9 @@ class Andersens: public ModulePass,
   virtual void getAnalysisUsage(AnalysisUsage &AU) const {
     AliasAnalysis::getAnalysisUsage(AU);
     AU.setPreservesAll();                         // Does not transform code
+    // Snapshots identify values by their IDs.
+    if (!SnapshotIn.empty() || !SnapshotOut.empty())
+      AU.addRequired<rcs::IDAssigner>();
   }
 
   //------------------------------------------------
@@ -543,6 +1217,15 @@ class Andersens: public ModulePass,
     getAnalysis<AliasAnalysis>().copyValue(From, To);
   }
 
+  //------------------------------------------------
+  // Support for AndersensPointerAnalysis
+  //
+  bool isFrozen() const { return Frozen; }
+  bool hasNode(const Value *V) const;
+  bool getPointees(const Value *Pointer, rcs::ValueList &Pointees);
+  bool getPointeeRange(const Value *Pointer, ArrayRef<Value *> &Pointees);
+  void BuildPointeeRanges();
+
  private:
   /// getNode - Return the node corresponding to the specified pointer scalar.
   ///
@@ -586,6 +1269,23 @@ class Andersens: public ModulePass,
     return I->second;
   }
 
+  /// addConstraint - Add C to the constraints, or to the buffer of the
+  /// function being visited on this thread.
+  void addConstraint(const Constraint &C) {
+    if (ConstraintBuffer *B = CurrentBuffer.get())
+      B->Constraints.push_back(C);
+    else
+      Constraints.push_back(C);
+  }
+
+  /// newTempNode - Create a node that stands for no value.
+  unsigned newTempNode() {
+    if (ConstraintBuffer *B = CurrentBuffer.get())
+      return B->FirstTemp + B->NumTemps++;
+    GraphNodes.push_back(Node());
+    return GraphNodes.size() - 1;
+  }
+
   /// getNodeValue - Get the node for the specified LLVM value and set the
   /// value for it to be the specified value.
   unsigned getNodeValue(Value &V) {
@@ -594,6 +1294,61 @@ class Andersens: public ModulePass,
     return Index;
   }
 
+  /// UpdateOldPointsTo - Record the current points-to set of N as the one
+  /// it had when last processed, interning it in shard S of SetStore.  N then
+  /// shares the interned set as its PointsTo until the set changes again.
+  void UpdateOldPointsTo(Node *N, unsigned S = 0) {
+    if (N->PointsTo == N->OldPointsTo)
+      return;
+    unsigned Old = N->OldPointsToSet;
+    N->OldPointsToSet = SetStore.intern(*N->PointsTo, S, &N->OldPointsTo);
+    SetStore.release(Old, S);
+    delete N->PointsTo;
+    N->PointsTo = const_cast<rcs::HybridBitSet *>(N->OldPointsTo);
+  }
+
+  void SetOldPointsTo(Node *N, const rcs::HybridBitSet &Bitmap) {
+    unsigned Old = N->OldPointsToSet;
+    N->OldPointsToSet = SetStore.intern(Bitmap, 0, &N->OldPointsTo);
+    SetStore.release(Old);
+  }
+
+  void ClearOldPointsTo(Node *N) {
+    UnsharePointsTo(N);
+    SetStore.release(N->OldPointsToSet);
+    N->OldPointsToSet = PointsToSetStore::EmptySet;
+    N->OldPointsTo = SetStore.getBitmap(N->OldPointsToSet);
+  }
+
+  /// UnsharePointsTo - Give N its own copy of a points-to set it shares with
+  /// SetStore.
+  void UnsharePointsTo(Node *N) {
+    if (N->PointsTo && N->PointsTo == N->OldPointsTo)
+      N->PointsTo = new rcs::HybridBitSet(*N->OldPointsTo);
+  }
+
+  /// UnionPointsTo - Add Bitmap to the points-to set of N, and return true if
+  /// the set changed.  A set N shares with SetStore is only copied when it
+  /// changes.
+  bool UnionPointsTo(Node *N, const rcs::HybridBitSet &Bitmap) {
+    if (N->PointsTo == N->OldPointsTo) {
+      rcs::HybridBitSet New;
+      New.intersectWithComplement(Bitmap, *N->PointsTo);
+      if (New.empty())
+        return false;
+      UnsharePointsTo(N);
+      return *N->PointsTo |= New;
+    }
+    return *N->PointsTo |= Bitmap;
+  }
+
+  /// FreePointsTo - Drop the points-to set of N, unless it is shared.
+  void FreePointsTo(Node *N) {
+    if (N->PointsTo != N->OldPointsTo)
+      delete N->PointsTo;
+    N->PointsTo = NULL;
+  }
+
   unsigned UniteNodes(unsigned First, unsigned Second,
                       bool UnionByRank = true);
   unsigned FindNode(unsigned Node);
@@ -601,11 +1356,49 @@ class Andersens: public ModulePass,
 
   void IdentifyObjects(Module &M);
   void CollectConstraints(Module &M);
+  void MergeConstraintBuffer(ConstraintBuffer &B);
+  void BeginConstraintGroup(Function *F, unsigned Index);
+  void EndConstraintGroup();
+  void ComputeNodeKeys(Module &M);
+  bool SolveIncrementally();
+  bool ReadIncrementalState(
+      std::vector<unsigned> &OldToNew,
+      std::vector<std::vector<unsigned> > &SavedPointsTo,
+      std::map<std::string, std::vector<Constraint> > &SavedGroups);
+  void WriteIncrementalState();
+  void CountGraph(unsigned &NumNodes, unsigned &NumEdges,
+                  unsigned &NumConstraints) const;
+  void RecordIteration(const char *Solver, unsigned Iteration,
+                       unsigned WorkListLength);
+  void WriteStatsJSON();
+  void BuildDemandIndex();
+  bool SolveOnDemand(unsigned Root);
+  bool isSolved(Node *N);
+  bool sharesObject(unsigned Rep1, unsigned Rep2);
+  void ClearAliasCache();
+  bool getNodeIfAny(Value *V, unsigned &NodeIndex) const;
+  bool isObjectNode(Value *V, unsigned NodeIndex) const {
+    DenseMap<Value*, unsigned>::const_iterator I = ObjectNodes.find(V);
+    return I != ObjectNodes.end() && I->second == NodeIndex;
+  }
+  unsigned getSolvedNode(const Value *V) const;
+  Value *getSolvedValue(unsigned N) const;
+  void FlattenSolution();
+  void Freeze();
+  static uint64_t HashModule(Module &M);
+  void WriteSnapshot(Module &M);
+  static void WriteArray(raw_ostream &Out, const std::vector<uint32_t> &A);
+  bool LoadSnapshot(Module &M);
+  void AddRemovalSeeds(const Constraint &C,
+                       const std::vector<unsigned> &OldToNew,
+                       const std::vector<std::vector<unsigned> > &SavedPointsTo,
+                       std::vector<unsigned> &Seeds) const;
   bool AnalyzeUsesOfFunction(Value *);
   void CreateConstraintGraph();
   void OptimizeConstraints();
   unsigned FindEquivalentNode(unsigned, unsigned);
   void ClumpAddressTaken();
+  void OrderUnaddressedNodes(std::vector<unsigned> &Order);
   void RewriteConstraints();
   void HU();
   void HVN();
@@ -613,7 +1406,20 @@ class Andersens: public ModulePass,
   void Search(unsigned Node);
   void UnitePointerEquivalences();
   void SolveConstraints();
+  void CreateSolverGraph();
+  void PropagateConstraints(WorkListKind Kind, unsigned NumThreads);
+  void FinishSolving();
+  void SolveWithLazyCycleDetection(WorkListKind Kind);
+  WorkList *CreateWorkList(WorkListKind Kind);
+  void ComputeTopoOrder();
+  void SaveSolverState(SolverState &S);
+  void RestoreSolverState(const SolverState &S);
+  void RunWorkListBenchmark();
+  void RunBitSetBenchmark();
+  void SolveWithWavePropagation();
   bool QueryNode(unsigned Node);
+  void WaveVisit(unsigned Node, std::vector<unsigned> &Finished);
+  bool getOffsetMember(unsigned Member, unsigned K, unsigned &Target) const;
   void Condense(unsigned Node);
   void HUValNum(unsigned Node);
   void HVNValNum(unsigned Node);
@@ -633,6 +1439,7 @@ class Andersens: public ModulePass,
   void PrintConstraint(const Constraint &) const;
   void PrintLabels() const;
   void PrintPointsToGraph() const;
+  void PrintSolvedNode(unsigned N) const;
 
   //===------------------------------------------------------------------===//
   // Instruction visitation methods for adding constraints
@@ -671,29 +1478,235 @@ char Andersens::ID = 0;
 static RegisterPass<Andersens>
 X("anders-aa", "Andersen's Interprocedural Alias Analysis", false, true);
 static RegisterAnalysisGroup<AliasAnalysis> Y(X);
+static RegisterAnalysisGroup<rcs::AnalysisOptions> OptionsGroup(X);
 
 // Initialize Timestamp Counter (static).
 volatile llvm::sys::cas_flag Andersens::Node::Counter = 0;
 
+//===----------------------------------------------------------------------===//
+//                             Instrumentation
+//===----------------------------------------------------------------------===//
+
+/// getPeakRSS - Return the peak resident set size of the process in KB.
+static long getPeakRSS() {
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage))
+    return 0;
+  return Usage.ru_maxrss;
+}
+
+/// PhaseScope - Record the time and memory spent until the end of the scope
+/// as a phase, if -anders-stats-json is given.  Phases may nest.
+class Andersens::PhaseScope {
+  Andersens &A;
+  unsigned Index;
+  TimeRecord Start;
+  long StartRSS;
+
+ public:
+  PhaseScope(Andersens &AA, const char *Name): A(AA), Index(0), StartRSS(0) {
+    if (StatsJSON.empty())
+      return;
+    Index = A.Phases.size();
+    A.Phases.push_back(PhaseRecord());
+    A.Phases.back().Name = Name;
+    A.Phases.back().Depth = A.PhaseDepth++;
+    StartRSS = getPeakRSS();
+    Start = TimeRecord::getCurrentTime(true);
+  }
+
+  ~PhaseScope() {
+    if (StatsJSON.empty())
+      return;
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+    --A.PhaseDepth;
+    PhaseRecord &R = A.Phases[Index];
+    R.Wall = End.getWallTime() - Start.getWallTime();
+    R.CPU = End.getProcessTime() - Start.getProcessTime();
+    R.PeakRSSDelta = getPeakRSS() - StartRSS;
+    A.CountGraph(R.Nodes, R.Edges, R.Constraints);
+  }
+};
+
+/// CountGraph - Count the nodes, the copy edges and the constraints that are
+/// currently in the graph.  It runs at the end of every phase, including the
+/// ones that free the edge sets, so whatever frees a node's Edges must reset
+/// it to NULL.
+void Andersens::CountGraph(unsigned &NumNodes, unsigned &NumEdges,
+                           unsigned &NumConstraints) const {
+  NumNodes = GraphNodes.size();
+  NumEdges = 0;
+  NumConstraints = Constraints.size();
+  for (unsigned i = 0; i < GraphNodes.size(); ++i) {
+    const Node *N = &GraphNodes[i];
+    if (N->Edges)
+      NumEdges += N->Edges->count();
+    NumConstraints += N->Constraints.size();
+  }
+}
+
+/// RecordIteration - Record the work list length and the sizes of the
+/// points-to sets at the start of a solver iteration, if -anders-stats-json
+/// is given.  Bucket 0 of the histogram counts the empty sets, and bucket
+/// B > 0 the sets with [2^(B-1), 2^B) elements.
+void Andersens::RecordIteration(const char *Solver, unsigned Iteration,
+                                unsigned WorkListLength) {
+  if (StatsJSON.empty())
+    return;
+  Iterations.push_back(IterationRecord());
+  IterationRecord &R = Iterations.back();
+  R.Solver = Solver;
+  R.Iteration = Iteration;
+  R.WorkList = WorkListLength;
+  for (unsigned i = 0; i < GraphNodes.size(); ++i) {
+    const Node *N = &GraphNodes[i];
+    if (!N->isRep() || !N->PointsTo)
+      continue;
+    unsigned Size = N->PointsTo->count();
+    unsigned Bucket = 0;
+    while (Size) {
+      ++Bucket;
+      Size >>= 1;
+    }
+    if (R.Histogram.size() <= Bucket)
+      R.Histogram.resize(Bucket + 1, 0);
+    ++R.Histogram[Bucket];
+  }
+}
+
+/// WriteStatsJSON - Write the recorded phases and iterations to the file
+/// given by -anders-stats-json.
+void Andersens::WriteStatsJSON() {
+  if (StatsJSON.empty())
+    return;
+  std::string ErrorInfo;
+  raw_fd_ostream Out(StatsJSON.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << ErrorInfo << "\n";
+    return;
+  }
+
+  Out << "{\n  \"phases\": [";
+  for (unsigned i = 0; i < Phases.size(); ++i) {
+    const PhaseRecord &R = Phases[i];
+    Out << (i ? ",\n" : "\n") << "    {\"name\": \"" << R.Name << "\", "
+        << "\"depth\": " << R.Depth << ", "
+        << format("\"wall\": %.6f, \"cpu\": %.6f, ", R.Wall, R.CPU)
+        << "\"peak_rss_delta_kb\": " << R.PeakRSSDelta << ", "
+        << "\"nodes\": " << R.Nodes << ", "
+        << "\"edges\": " << R.Edges << ", "
+        << "\"constraints\": " << R.Constraints << "}";
+  }
+  Out << "\n  ],\n  \"iterations\": [";
+  for (unsigned i = 0; i < Iterations.size(); ++i) {
+    const IterationRecord &R = Iterations[i];
+    Out << (i ? ",\n" : "\n") << "    {\"solver\": \"" << R.Solver << "\", "
+        << "\"iteration\": " << R.Iteration << ", "
+        << "\"worklist\": " << R.WorkList << ", "
+        << "\"pts_histogram\": [";
+    for (unsigned j = 0; j < R.Histogram.size(); ++j)
+      Out << (j ? ", " : "") << R.Histogram[j];
+    Out << "]}";
+  }
+  Out << "\n  ]\n}\n";
+}
+
 //===----------------------------------------------------------------------===//
 //                  AliasAnalysis Interface Implementation
 //===----------------------------------------------------------------------===//
 
+// Once the solution is frozen, these queries only read Solved, ValueNodes and
+// IDA, and update AliasCache without locks, so several threads may call them
+// at once.  Solved.Reps already maps every node to its final representative,
+// so no path compression happens on the way.  What they cannot answer goes to
+// the next analysis in the chain, which must allow concurrent callers too.
+// getMustAliases may create a null constant in the LLVMContext, so it is the
+// exception.
+
 AliasAnalysis::AliasResult Andersens::alias(const Location &L1,
                                             const Location &L2) {
-  Node *N1 = &GraphNodes[FindNode(getNode(const_cast<Value*>(L1.Ptr)))];
-  Node *N2 = &GraphNodes[FindNode(getNode(const_cast<Value*>(L2.Ptr)))];
+  if (Frozen) {
+    unsigned S1 = getSolvedNode(L1.Ptr), S2 = getSolvedNode(L2.Ptr);
+    if (S1 != ~0U && S2 != ~0U && !sharesObject(S1, S2))
+      return NoAlias;
+    return AliasAnalysis::alias(L1, L2);
+  }
+
+  // Values created after the analysis ran, e.g. by a transform that keeps
+  // the analysis alive, have no node.
+  unsigned Rep1, Rep2;
+  if (!getNodeIfAny(const_cast<Value*>(L1.Ptr), Rep1) ||
+      !getNodeIfAny(const_cast<Value*>(L2.Ptr), Rep2))
+    return AliasAnalysis::alias(L1, L2);
+  Rep1 = FindNode(Rep1);
+  Rep2 = FindNode(Rep2);
+  if (!isSolved(&GraphNodes[Rep1]) || !isSolved(&GraphNodes[Rep2]))
+    return AliasAnalysis::alias(L1, L2);
 
   // Check to see if the two pointers are known to not alias.  They don't alias
   // if their points-to sets do not intersect.
 //  if (!N1->PointsTo->test(UniversalSet) && !N2->PointsTo->test(UniversalSet)) {
-  if (!N1->intersectsIgnoring(N2, NullObject))
+  if (!sharesObject(Rep1, Rep2))
     return NoAlias;
 //  }
 
   return AliasAnalysis::alias(L1, L2);
 }
 
+/// sharesObject - Return true if the points-to sets of the two representatives
+/// (nodes of Solved once frozen) share an object other than the null object.
+/// Pointers in the same equivalence class share the cached answer.  Once
+/// frozen, it may be called from several threads at once.
+bool Andersens::sharesObject(unsigned Rep1, unsigned Rep2) {
+  if (Rep1 > Rep2)
+    std::swap(Rep1, Rep2);
+  // Representatives are packed into 31 bits each; larger ones bypass the
+  // cache.
+  uint64_t *Slot = NULL;
+  uint64_t Key = 0, Entry = 0;
+  if (!AliasCache.empty() && Rep2 < (1U << 31)) {
+    Key = (uint64_t)Rep1 << 31 | Rep2;
+    unsigned Hash = PairKeyInfo::getHashValue(std::make_pair(Rep1, Rep2));
+    Slot = &AliasCache[Hash & (AliasCache.size() - 1)];
+    Entry = *(volatile uint64_t *)Slot;
+    if ((Entry & AliasCacheValid) && (Entry & AliasCacheKeyMask) == Key) {
+      // Frozen queries may run on several threads, and atomic increments
+      // of a shared counter would serialize them.
+      if (!Frozen)
+        ++NumAliasCacheHits;
+      return Entry & AliasCacheShares;
+    }
+  }
+  if (!Frozen)
+    ++NumAliasCacheMisses;
+
+  bool Result;
+  if (Frozen)
+    Result = Solved.intersectsIgnoring(Rep1, Rep2, NullObject);
+  else
+    Result = SetStore.intersectsIgnoring(GraphNodes[Rep1].PointsToSet,
+                                         GraphNodes[Rep2].PointsToSet,
+                                         NullObject);
+  if (Slot) {
+    __sync_bool_compare_and_swap(
+        Slot, Entry, AliasCacheValid | (Result ? AliasCacheShares : 0) | Key);
+  }
+  return Result;
+}
+
+/// ClearAliasCache - Empty AliasCache, allocating it on first use.
+void Andersens::ClearAliasCache() {
+  if (AliasCacheSize == 0)
+    return;
+  size_t Size = 1;
+  while (Size < AliasCacheSize)
+    Size <<= 1;
+  if (AliasCache.size() == Size)
+    std::fill(AliasCache.begin(), AliasCache.end(), 0);
+  else
+    std::vector<uint64_t>(Size, 0).swap(AliasCache);
+}
+
 AliasAnalysis::ModRefResult
 Andersens::getModRefInfo(ImmutableCallSite CS, const Location &Loc) {
   // The only thing useful that we can contribute for mod/ref information is
@@ -706,7 +1719,19 @@ Andersens::getModRefInfo(ImmutableCallSite CS, const Location &Loc) {
   // is, after all, a "research quality" implementation of Andersen's analysis.
   if (const Function *F = CS.getCalledFunction())
     if (F->isDeclaration()) {
-      Node *N1 = &GraphNodes[FindNode(getNode(const_cast<Value *>(Loc.Ptr)))];
+      if (Frozen) {
+        unsigned S = getSolvedNode(Loc.Ptr);
+        if (S != ~0U && (Solved.empty(S) || !Solved.contains(S, UniversalSet)))
+          return NoModRef;
+        return AliasAnalysis::getModRefInfo(CS, Loc);
+      }
+
+      unsigned NodeIndex;
+      if (!getNodeIfAny(const_cast<Value *>(Loc.Ptr), NodeIndex))
+        return AliasAnalysis::getModRefInfo(CS, Loc);
+      Node *N1 = &GraphNodes[FindNode(NodeIndex)];
+      if (!isSolved(N1))
+        return AliasAnalysis::getModRefInfo(CS, Loc);
 
       if (N1->PointsTo->empty())
         return NoModRef;
@@ -733,7 +1758,26 @@ Andersens::getModRefInfo(ImmutableCallSite CS1, ImmutableCallSite CS2) {
 /// variables or any other memory memory objects because we do not track whether
 /// a pointer points to the beginning of an object or a field of it.
 void Andersens::getMustAliases(Value *P, std::vector<Value*> &RetVals) {
-  Node *N = &GraphNodes[FindNode(getNode(P))];
+  if (Frozen) {
+    unsigned S = getSolvedNode(P);
+    if (S == ~0U || Solved.end(S) - Solved.begin(S) != 1)
+      return;
+    unsigned Pointee = *Solved.begin(S);
+    if (Pointee == NullObject) {
+      RetVals.push_back(Constant::getNullValue(P->getType()));
+    } else if (Function *F =
+                   dyn_cast_or_null<Function>(getSolvedValue(Pointee))) {
+      RetVals.push_back(F);
+    }
+    return;
+  }
+
+  unsigned NodeIndex;
+  if (!getNodeIfAny(P, NodeIndex))
+    return;
+  Node *N = &GraphNodes[FindNode(NodeIndex)];
+  if (!isSolved(N))
+    return;
   if (N->PointsTo->count() == 1) {
     Node *Pointee = &GraphNodes[N->PointsTo->find_first()];
     // If a function is the only object in the points-to set, then it must be
@@ -760,10 +1804,25 @@ void Andersens::getMustAliases(Value *P, std::vector<Value*> &RetVals) {
 /// return true.
 ///
 bool Andersens::pointsToConstantMemory(const Location &Loc, bool OrLocal) {
-  Node *N = &GraphNodes[FindNode(getNode(const_cast<Value*>(Loc.Ptr)))];
+  if (Frozen) {
+    unsigned S = getSolvedNode(Loc.Ptr);
+    if (S == ~0U)
+      return AliasAnalysis::pointsToConstantMemory(Loc);
+    for (const uint32_t *I = Solved.begin(S), *E = Solved.end(S); I != E; ++I) {
+      if (!(Solved.NodeFlags[*I] & SolvedGraph::ConstantMemory))
+        return AliasAnalysis::pointsToConstantMemory(Loc);
+    }
+    return true;
+  }
+
   unsigned i;
+  if (!getNodeIfAny(const_cast<Value*>(Loc.Ptr), i))
+    return AliasAnalysis::pointsToConstantMemory(Loc);
+  Node *N = &GraphNodes[FindNode(i)];
+  if (!isSolved(N))
+    return AliasAnalysis::pointsToConstantMemory(Loc);
 
-  for (SparseBitVector<>::iterator bi = N->PointsTo->begin();
+  for (rcs::HybridBitSet::iterator bi = N->PointsTo->begin();
        bi != N->PointsTo->end();
        ++bi) {
     i = *bi;
@@ -781,23 +1840,197 @@ bool Andersens::pointsToConstantMemory(const Location &Loc, bool OrLocal) {
   return true;
 }
 
-//===----------------------------------------------------------------------===//
-//                       Object Identification Phase
-//===----------------------------------------------------------------------===//
+/// hasNode - Return true if V is a pointer with a node.
+bool Andersens::hasNode(const Value *V) const {
+  if (Frozen)
+    return getSolvedNode(V) != ~0U;
+  unsigned NodeIndex;
+  return getNodeIfAny(const_cast<Value *>(V), NodeIndex);
+}
 
-/// IdentifyObjects - This stage scans the program, adding an entry to the
-/// GraphNodes list for each memory object in the program (global stack or
-/// heap), and populates the ValueNodes and ObjectNodes maps for these objects.
-///
-void Andersens::IdentifyObjects(Module &M) {
-  unsigned NumObjects = 0;
+/// getPointees - Append the objects Pointer may point to to Pointees.  The
+/// universal set and the null object are left out.  Returns false if Pointer
+/// has no points-to set.
+bool Andersens::getPointees(const Value *Pointer, rcs::ValueList &Pointees) {
+  if (Frozen) {
+    unsigned S = getSolvedNode(Pointer);
+    if (S == ~0U)
+      return false;
+    for (const uint32_t *I = Solved.begin(S), *E = Solved.end(S); I != E; ++I) {
+      if (Solved.NodeFlags[*I] & SolvedGraph::Object)
+        Pointees.push_back(getSolvedValue(*I));
+    }
+    return true;
+  }
 
-  // Object #0 is always the universal set: the object that we don't know
-  // anything about.
-  assert(NumObjects == UniversalSet && "Something changed!");
-  ++NumObjects;
+  unsigned NodeIndex;
+  if (!getNodeIfAny(const_cast<Value *>(Pointer), NodeIndex))
+    return false;
+  Node *N = &GraphNodes[FindNode(NodeIndex)];
+  if (!isSolved(N))
+    return false;
+  for (rcs::HybridBitSet::iterator bi = N->PointsTo->begin();
+       bi != N->PointsTo->end(); ++bi) {
+    Value *V = GraphNodes[*bi].getValue();
+    if (V && isObjectNode(V, *bi))
+      Pointees.push_back(V);
+  }
+  return true;
+}
 
-  // Object #1 always represents the null pointer.
+/// BuildPointeeRanges - Groups the objects of the frozen solution by
+/// points-to set, unless done already.  getPointeeRange is read-only, and
+/// therefore thread-safe, after this.
+void Andersens::BuildPointeeRanges() {
+  assert(Frozen && "Pointees are only grouped by set once frozen");
+  if (!SetPointeesBegin.empty())
+    return;
+  SetPointeesBegin.reserve(Solved.NumSets + 1);
+  SetPointeesBegin.push_back(0);
+  for (unsigned Set = 0; Set < Solved.NumSets; ++Set) {
+    for (unsigned i = Solved.SetBegin[Set]; i < Solved.SetBegin[Set + 1];
+         ++i) {
+      unsigned Element = Solved.Elements[i];
+      if (Solved.NodeFlags[Element] & SolvedGraph::Object)
+        SetPointees.push_back(getSolvedValue(Element));
+    }
+    SetPointeesBegin.push_back(SetPointees.size());
+  }
+}
+
+/// getPointeeRange - Like getPointees, but returns a view of the objects,
+/// which are stored once per points-to set.
+bool Andersens::getPointeeRange(const Value *Pointer,
+                                ArrayRef<Value *> &Pointees) {
+  if (!Frozen) {
+    unsigned NodeIndex;
+    if (!getNodeIfAny(const_cast<Value *>(Pointer), NodeIndex))
+      return false;
+    Node *N = &GraphNodes[FindNode(NodeIndex)];
+    if (!isSolved(N))
+      return false;
+    std::map<unsigned, rcs::ValueList>::iterator I =
+        StorePointees.find(N->PointsToSet);
+    if (I == StorePointees.end()) {
+      I = StorePointees.insert(
+          std::make_pair(N->PointsToSet, rcs::ValueList())).first;
+      getPointees(Pointer, I->second);
+    }
+    Pointees = I->second;
+    return true;
+  }
+
+  unsigned S = getSolvedNode(Pointer);
+  if (S == ~0U)
+    return false;
+
+  BuildPointeeRanges();
+  unsigned Set = Solved.NodeSets[S];
+  unsigned Begin = SetPointeesBegin[Set], End = SetPointeesBegin[Set + 1];
+  if (Begin == End)
+    Pointees = ArrayRef<Value *>();
+  else
+    Pointees = ArrayRef<Value *>(&SetPointees[Begin], End - Begin);
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                  PointerAnalysis Interface Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// AndersensPointerAnalysis - Implements rcs::PointerAnalysis by reading the
+/// points-to sets Andersens has solved, so that listing every pointee takes
+/// time linear in the output.
+struct AndersensPointerAnalysis: public ModulePass,
+                                 public rcs::PointerAnalysis {
+  static char ID;
+
+  AndersensPointerAnalysis(): ModulePass(ID) {}
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.setPreservesAll();
+    AU.addRequired<rcs::IDAssigner>();
+    AU.addRequired<Andersens>();
+  }
+  virtual bool runOnModule(Module &M) {
+    // Build the views up front so that queries don't write, and clients may
+    // query from multiple threads.
+    Andersens &AA = getAnalysis<Andersens>();
+    if (AA.isFrozen())
+      AA.BuildPointeeRanges();
+    return false;
+  }
+
+  virtual void getAllPointers(rcs::ValueList &Pointers);
+  virtual bool getPointees(const Value *Pointer, rcs::ValueList &Pointees);
+  virtual bool getPointeeRange(const Value *Pointer,
+                               ArrayRef<Value *> &Pointees);
+  // Unfrozen solutions compress paths and group pointees as queried.
+  virtual bool isThreadSafe() { return getAnalysis<Andersens>().isFrozen(); }
+
+  virtual void *getAdjustedAnalysisPointer(AnalysisID PI) {
+    if (PI == &rcs::PointerAnalysis::ID)
+      return (rcs::PointerAnalysis *)this;
+    return this;
+  }
+};
+}
+
+char AndersensPointerAnalysis::ID = 0;
+static RegisterPass<AndersensPointerAnalysis>
+PA("anders-pa", "Andersen's Pointer Analysis", false, true);
+static RegisterAnalysisGroup<rcs::PointerAnalysis> PAGroup(PA);
+
+void AndersensPointerAnalysis::getAllPointers(rcs::ValueList &Pointers) {
+  rcs::IDAssigner &IDA = getAnalysis<rcs::IDAssigner>();
+  Andersens &AA = getAnalysis<Andersens>();
+
+  // Same pointers as BasicPointerAnalysis, except those without a node.
+  Pointers.clear();
+  for (unsigned i = 0; i < IDA.getNumValues(); ++i) {
+    Value *V = IDA.getValue(i);
+    if (!V->getType()->isPointerTy())
+      continue;
+    if (Argument *Arg = dyn_cast<Argument>(V)) {
+      if (Arg->getParent()->isDeclaration())
+        continue;
+    }
+    if (AA.hasNode(V))
+      Pointers.push_back(V);
+  }
+}
+
+bool AndersensPointerAnalysis::getPointees(const Value *Pointer,
+                                           rcs::ValueList &Pointees) {
+  assert(Pointer->getType()->isPointerTy() && "<Pointer> is not a pointer");
+  Pointees.clear();
+  return getAnalysis<Andersens>().getPointees(Pointer, Pointees);
+}
+
+bool AndersensPointerAnalysis::getPointeeRange(const Value *Pointer,
+                                               ArrayRef<Value *> &Pointees) {
+  assert(Pointer->getType()->isPointerTy() && "<Pointer> is not a pointer");
+  return getAnalysis<Andersens>().getPointeeRange(Pointer, Pointees);
+}
+
+//===----------------------------------------------------------------------===//
+//                       Object Identification Phase
+//===----------------------------------------------------------------------===//
+
+/// IdentifyObjects - This stage scans the program, adding an entry to the
+/// GraphNodes list for each memory object in the program (global stack or
+/// heap), and populates the ValueNodes and ObjectNodes maps for these objects.
+///
+void Andersens::IdentifyObjects(Module &M) {
+  PhaseScope Phase(*this, "IdentifyObjects");
+  unsigned NumObjects = 0;
+
+  // Object #0 is always the universal set: the object that we don't know
+  // anything about.
+  assert(NumObjects == UniversalSet && "Something changed!");
+  ++NumObjects;
+
+  // Object #1 always represents the null pointer.
   assert(NumObjects == NullPtr && "Something changed!");
   ++NumObjects;
 
@@ -953,10 +2186,10 @@ void Andersens::AddGlobalInitializerConstraints(unsigned NodeIndex,
                                                 Constant *C) {
   if (C->getType()->isSingleValueType()) {
     if (isa<PointerType>(C->getType()))
-      Constraints.push_back(Constraint(Constraint::Copy, NodeIndex,
+      addConstraint(Constraint(Constraint::Copy, NodeIndex,
                                        getNodeForConstantPointer(C)));
   } else if (C->isNullValue()) {
-    Constraints.push_back(Constraint(Constraint::Copy, NodeIndex,
+    addConstraint(Constraint(Constraint::Copy, NodeIndex,
                                      NullObject));
     return;
   } else if (!isa<UndefValue>(C)) {
@@ -981,7 +2214,7 @@ void Andersens::AddConstraintsForNonInternalLinkage(Function *F) {
     if (isa<PointerType>(I->getType()))
       // If this is an argument of an externally accessible function, the
       // incoming pointer might point to anything.
-      Constraints.push_back(Constraint(Constraint::Copy, getNode(I),
+      addConstraint(Constraint(Constraint::Copy, getNode(I),
                                        UniversalSet));
 }
 
@@ -1046,14 +2279,13 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
       // constraint.  It is broken up into *Dest = temp, temp = *Src
       unsigned FirstArg = getNode(CS.getArgument(0));
       unsigned SecondArg = getNode(CS.getArgument(1));
-      unsigned TempArg = GraphNodes.size();
-      GraphNodes.push_back(Node());
-      Constraints.push_back(Constraint(Constraint::Store,
+      unsigned TempArg = newTempNode();
+      addConstraint(Constraint(Constraint::Store,
                                        FirstArg, TempArg));
-      Constraints.push_back(Constraint(Constraint::Load,
+      addConstraint(Constraint(Constraint::Load,
                                        TempArg, SecondArg));
       // In addition, Dest = Src
-      Constraints.push_back(Constraint(Constraint::Copy,
+      addConstraint(Constraint(Constraint::Copy,
                                        FirstArg, SecondArg));
       return true;
     }
@@ -1068,7 +2300,7 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
     const FunctionType *FTy = F->getFunctionType();
     if (FTy->getNumParams() > 0 &&
         isa<PointerType>(FTy->getParamType(0))) {
-      Constraints.push_back(Constraint(Constraint::Copy,
+      addConstraint(Constraint(Constraint::Copy,
                                        getNode(CS.getInstruction()),
                                        getNode(CS.getArgument(0))));
       return true;
@@ -1079,7 +2311,7 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
     const FunctionType *FTy = F->getFunctionType();
     if (FTy->getNumParams() > 0 &&
         isa<PointerType>(FTy->getParamType(1))) {
-      Constraints.push_back(Constraint(Constraint::Copy,
+      addConstraint(Constraint(Constraint::Copy,
                                        getNode(CS.getInstruction()),
                                        getNode(CS.getArgument(1))));
       return true;
@@ -1090,7 +2322,7 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
     const FunctionType *FTy = F->getFunctionType();
     if (FTy->getNumParams() > 0 &&
         isa<PointerType>(FTy->getParamType(2))) {
-      Constraints.push_back(Constraint(Constraint::Copy,
+      addConstraint(Constraint(Constraint::Copy,
                                        getNode(CS.getInstruction()),
                                        getNode(CS.getArgument(2))));
       return true;
@@ -1106,11 +2338,10 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
         assert(ParentF->getFunctionType()->isVarArg()
             && "va_start in non-vararg function!");
         Value *Arg = II->getArgOperand(0);
-        unsigned TempArg = GraphNodes.size();
-        GraphNodes.push_back(Node());
-        Constraints.push_back(Constraint(Constraint::AddressOf, TempArg,
+        unsigned TempArg = newTempNode();
+        addConstraint(Constraint(Constraint::AddressOf, TempArg,
               getVarargNode(ParentF)));
-        Constraints.push_back(Constraint(Constraint::Store, getNode(Arg),
+        addConstraint(Constraint(Constraint::Store, getNode(Arg),
               TempArg));
         return true;
       } else if (IID == Intrinsic::vaend) {
@@ -1129,7 +2360,7 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
       // Copy the actual argument into the formal argument.
       Value *ThrFunc = I->getOperand(2);
       Value *Arg = I->getOperand(3);
-      Constraints.push_back(Constraint(Constraint::Store,
+      addConstraint(Constraint(Constraint::Store,
                                        getNode(ThrFunc),
                                        getNode(Arg), CallFirstArgPos));
       return true;
@@ -1139,7 +2370,7 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
   if (F->getName() == "pthread_getspecific") {
     const FunctionType *FTy = F->getFunctionType();
     if (FTy->getNumParams() == 1 && isa<PointerType>(FTy->getReturnType())) {
-      Constraints.push_back(Constraint(Constraint::Copy,
+      addConstraint(Constraint(Constraint::Copy,
                                        getNode(CS.getInstruction()),
                                        PthreadSpecificNode));
       return true;
@@ -1147,7 +2378,7 @@ bool Andersens::AddConstraintsForExternalCall(CallSite CS, Function *F) {
   } else if (F->getName() == "pthread_setspecific") {
     const FunctionType *FTy = F->getFunctionType();
     if (FTy->getNumParams() == 2 && isa<PointerType>(FTy->getParamType(1))) {
-      Constraints.push_back(Constraint(Constraint::Copy,
+      addConstraint(Constraint(Constraint::Copy,
                                        PthreadSpecificNode,
                                        getNode(CS.getInstruction()->getOperand(1))));
       return true;
@@ -1214,14 +2445,17 @@ return false;
 /// constraint, and setting up the initial points-to graph.
 ///
 void Andersens::CollectConstraints(Module &M) {
+  PhaseScope Phase(*this, "CollectConstraints");
+  BeginConstraintGroup(NULL, 0);
+
   // First, the universal set points to itself.
-  Constraints.push_back(Constraint(Constraint::AddressOf, UniversalSet,
+  addConstraint(Constraint(Constraint::AddressOf, UniversalSet,
                                    UniversalSet));
-  Constraints.push_back(Constraint(Constraint::Store, UniversalSet,
+  addConstraint(Constraint(Constraint::Store, UniversalSet,
                                    UniversalSet));
 
   // Next, the null pointer points to the null object.
-  Constraints.push_back(Constraint(Constraint::AddressOf, NullPtr, NullObject));
+  addConstraint(Constraint(Constraint::AddressOf, NullPtr, NullObject));
 
   // Next, add any constraints on global variables and their initializers.
   for (Module::global_iterator I = M.global_begin(), E = M.global_end();
@@ -1231,7 +2465,7 @@ void Andersens::CollectConstraints(Module &M) {
     unsigned ObjectIndex = getObject(I);
     Node *Object = &GraphNodes[ObjectIndex];
     Object->setValue(I);
-    Constraints.push_back(Constraint(Constraint::AddressOf, getNodeValue(*I),
+    addConstraint(Constraint(Constraint::AddressOf, getNodeValue(*I),
                                      ObjectIndex));
 
     if (I->hasDefinitiveInitializer()) {
@@ -1241,9 +2475,9 @@ void Andersens::CollectConstraints(Module &M) {
     } else {
       // If it doesn't have an initializer (i.e. it's defined in another
       // translation unit), it points to the universal set.
-      Constraints.push_back(Constraint(Constraint::Copy, ObjectIndex,
+      addConstraint(Constraint(Constraint::Copy, ObjectIndex,
                                        UniversalSet));
-      Constraints.push_back(Constraint(Constraint::Copy, getNode(I),
+      addConstraint(Constraint(Constraint::Copy, getNode(I),
                                        UniversalSet));
     }
   }
@@ -1252,12 +2486,31 @@ void Andersens::CollectConstraints(Module &M) {
     unsigned ObjectIndex = getObject(F);
     Node *Object = &GraphNodes[ObjectIndex];
     Object->setValue(F);
-    Constraints.push_back(Constraint(Constraint::AddressOf, getNodeValue(*F),
+    addConstraint(Constraint(Constraint::AddressOf, getNodeValue(*F),
                                      ObjectIndex));
     AddConstraintForConstantPointer(F);
   }
 
+  // Function bodies only read the node maps and set the values of their own
+  // nodes, so they can be visited in parallel.  Their constraints are then
+  // merged below in module order, giving the same constraints and node
+  // numbers as a serial visit.
+  std::vector<Function *> Defined;
+  std::vector<ConstraintBuffer> Buffers;
+  if (AndersThreads > 1) {
+    for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+      if (!F->isDeclaration())
+        Defined.push_back(F);
+    }
+    Buffers.resize(Defined.size());
+    CollectBody Body(*this, Defined, Buffers);
+    rcs::ParallelFor(AndersThreads, Defined.size(), Body, 1);
+  }
+
+  unsigned FuncIndex = 0, DefinedIndex = 0;
   for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    BeginConstraintGroup(F, FuncIndex++);
+
     // Set up the return value node.
     if (isa<PointerType>(F->getFunctionType()->getReturnType()))
       GraphNodes[getReturnNode(F)].setValue(F);
@@ -1280,11 +2533,14 @@ void Andersens::CollectConstraints(Module &M) {
       // Scan the function body, creating a memory object for each heap/stack
       // allocation in the body of the function and a node to represent all
       // pointer values defined by instructions and used as operands.
-      visit(F);
+      if (Buffers.empty())
+        visit(F);
+      else
+        MergeConstraintBuffer(Buffers[DefinedIndex++]);
     } else {
       // External functions that return pointers return the universal set.
       if (isa<PointerType>(F->getFunctionType()->getReturnType()))
-        Constraints.push_back(Constraint(Constraint::Copy,
+        addConstraint(Constraint(Constraint::Copy,
                                          getReturnNode(F),
                                          UniversalSet));
 
@@ -1295,16 +2551,16 @@ void Andersens::CollectConstraints(Module &M) {
         if (isa<PointerType>(I->getType())) {
           // Pointers passed into external functions could have anything stored
           // through them.
-          Constraints.push_back(Constraint(Constraint::Store, getNode(I),
+          addConstraint(Constraint(Constraint::Store, getNode(I),
                                            UniversalSet));
           // Memory objects passed into external function calls can have the
           // universal set point to them.
 #if FULL_UNIVERSAL
-          Constraints.push_back(Constraint(Constraint::Copy,
+          addConstraint(Constraint(Constraint::Copy,
                                            UniversalSet,
                                            getNode(I)));
 #else
-          Constraints.push_back(Constraint(Constraint::Copy,
+          addConstraint(Constraint(Constraint::Copy,
                                            getNode(I),
                                            UniversalSet));
 #endif
@@ -1313,14 +2569,51 @@ void Andersens::CollectConstraints(Module &M) {
       // If this is an external varargs function, it can also store pointers
       // into any pointers passed through the varargs section.
       if (F->getFunctionType()->isVarArg())
-        Constraints.push_back(Constraint(Constraint::Store, getVarargNode(F),
+        addConstraint(Constraint(Constraint::Store, getVarargNode(F),
                                          UniversalSet));
     }
   }
+  EndConstraintGroup();
   NumConstraints += Constraints.size();
 }
 
 
+/// CollectBody - Visits one function per index into its own buffer.
+struct Andersens::CollectBody {
+  Andersens &A;
+  const std::vector<Function *> &Functions;
+  std::vector<ConstraintBuffer> &Buffers;
+  unsigned FirstTemp;
+
+  CollectBody(Andersens &AA, const std::vector<Function *> &Fs,
+              std::vector<ConstraintBuffer> &Bs):
+      A(AA), Functions(Fs), Buffers(Bs), FirstTemp(AA.GraphNodes.size()) {}
+
+  void operator()(size_t I, unsigned ThreadID) {
+    ConstraintBuffer &B = Buffers[I];
+    B.FirstTemp = FirstTemp;
+    A.CurrentBuffer.set(&B);
+    A.visit(*Functions[I]);
+    A.CurrentBuffer.set(NULL);
+  }
+};
+
+/// MergeConstraintBuffer - Append the constraints of a function visited in
+/// parallel, giving its temporary nodes the next free numbers.
+void Andersens::MergeConstraintBuffer(ConstraintBuffer &B) {
+  unsigned Offset = GraphNodes.size() - B.FirstTemp;
+  GraphNodes.resize(GraphNodes.size() + B.NumTemps);
+  for (unsigned i = 0; i < B.Constraints.size(); ++i) {
+    Constraint C = B.Constraints[i];
+    if (C.Src >= B.FirstTemp)
+      C.Src += Offset;
+    if (C.Dest >= B.FirstTemp)
+      C.Dest += Offset;
+    Constraints.push_back(C);
+  }
+  std::vector<Constraint>().swap(B.Constraints);
+}
+
 void Andersens::visitInstruction(Instruction &I) {
 #ifdef NDEBUG
   return;          // This function is just a big assert.
@@ -1355,14 +2648,14 @@ void Andersens::visitInstruction(Instruction &I) {
 void Andersens::visitAllocaInst(AllocaInst &AI) {
   unsigned ObjectIndex = getObject(&AI);
   GraphNodes[ObjectIndex].setValue(&AI);
-  Constraints.push_back(Constraint(Constraint::AddressOf, getNodeValue(AI),
+  addConstraint(Constraint(Constraint::AddressOf, getNodeValue(AI),
                                    ObjectIndex));
 }
 
 void Andersens::visitReturnInst(ReturnInst &RI) {
   if (RI.getNumOperands() && isa<PointerType>(RI.getOperand(0)->getType()))
     // return V   -->   <Copy/retval{F}/v>
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
                                      getReturnNode(RI.getParent()->getParent()),
                                      getNode(RI.getOperand(0))));
 }
@@ -1370,14 +2663,14 @@ void Andersens::visitReturnInst(ReturnInst &RI) {
 void Andersens::visitLoadInst(LoadInst &LI) {
   if (isa<PointerType>(LI.getType()))
     // P1 = load P2  -->  <Load/P1/P2>
-    Constraints.push_back(Constraint(Constraint::Load, getNodeValue(LI),
+    addConstraint(Constraint(Constraint::Load, getNodeValue(LI),
                                      getNode(LI.getOperand(0))));
   else if (isa<PointerType>(LI.getOperand(0)->getType()) &&
       isa<IntegerType>(LI.getType())) {
-    Constraints.push_back(Constraint(Constraint::Load, IntNode,
+    addConstraint(Constraint(Constraint::Load, IntNode,
                                      getNode(LI.getOperand(0))));
   } else if (isa<StructType>(LI.getType())) {
-    Constraints.push_back(Constraint(Constraint::Load, AggregateNode,
+    addConstraint(Constraint(Constraint::Load, AggregateNode,
                                      getNode(LI.getOperand(0))));
   }
 }
@@ -1385,26 +2678,26 @@ void Andersens::visitLoadInst(LoadInst &LI) {
 void Andersens::visitStoreInst(StoreInst &SI) {
   if (isa<PointerType>(SI.getOperand(0)->getType()))
     // store P1, P2  -->  <Store/P2/P1>
-    Constraints.push_back(Constraint(Constraint::Store,
+    addConstraint(Constraint(Constraint::Store,
                                      getNode(SI.getOperand(1)),
                                      getNode(SI.getOperand(0))));
   else if (ConstantExpr *CE = dyn_cast<ConstantExpr>(SI.getOperand(0))) {
     if (CE->getOpcode() == Instruction::PtrToInt) {
-      Constraints.push_back(Constraint(Constraint::Store,
+      addConstraint(Constraint(Constraint::Store,
             getNode(SI.getOperand(1)), getNode(CE->getOperand(0))));
     }
   } else if (isa<IntegerType>(SI.getOperand(0)->getType()) &&
       isa<PointerType>(SI.getOperand(1)->getType())) {
-    Constraints.push_back(Constraint(Constraint::Store,
+    addConstraint(Constraint(Constraint::Store,
           getNode(SI.getOperand(1)), IntNode));
   } else if (isa<StructType>(SI.getOperand(0)->getType()))
-    Constraints.push_back(Constraint(Constraint::Store,
+    addConstraint(Constraint(Constraint::Store,
           getNode(SI.getOperand(1)), AggregateNode));
 }
 
 void Andersens::visitGetElementPtrInst(GetElementPtrInst &GEP) {
   // P1 = getelementptr P2, ... --> <Copy/P1/P2>
-  Constraints.push_back(Constraint(Constraint::Copy, getNodeValue(GEP),
+  addConstraint(Constraint(Constraint::Copy, getNodeValue(GEP),
                                    getNode(GEP.getOperand(0))));
 }
 
@@ -1413,7 +2706,7 @@ void Andersens::visitPHINode(PHINode &PN) {
     unsigned PNN = getNodeValue(PN);
     for (unsigned i = 0, e = PN.getNumIncomingValues(); i != e; ++i)
       // P1 = phi P2, P3  -->  <Copy/P1/P2>, <Copy/P1/P3>, ...
-      Constraints.push_back(Constraint(Constraint::Copy, PNN,
+      addConstraint(Constraint(Constraint::Copy, PNN,
                                        getNode(PN.getIncomingValue(i))));
   }
 }
@@ -1423,12 +2716,12 @@ void Andersens::visitCastInst(CastInst &CI) {
   if (isa<PointerType>(CI.getType())) {
     if (isa<PointerType>(Op->getType())) {
       // P1 = cast P2  --> <Copy/P1/P2>
-      Constraints.push_back(Constraint(Constraint::Copy, getNodeValue(CI),
+      addConstraint(Constraint(Constraint::Copy, getNodeValue(CI),
                                        getNode(CI.getOperand(0))));
     } else {
       // P1 = cast int --> <Copy/P1/Univ>
 #if 0
-      Constraints.push_back(Constraint(Constraint::Copy, getNodeValue(CI),
+      addConstraint(Constraint(Constraint::Copy, getNodeValue(CI),
                                        UniversalSet));
 #else
       getNodeValue(CI);
@@ -1437,7 +2730,7 @@ void Andersens::visitCastInst(CastInst &CI) {
   } else if (isa<PointerType>(Op->getType())) {
     // int = cast P1 --> <Copy/Univ/P1>
 #if 0
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
                                      UniversalSet,
                                      getNode(CI.getOperand(0))));
 #else
@@ -1450,9 +2743,9 @@ void Andersens::visitSelectInst(SelectInst &SI) {
   if (isa<PointerType>(SI.getType())) {
     unsigned SIN = getNodeValue(SI);
     // P1 = select C, P2, P3   ---> <Copy/P1/P2>, <Copy/P1/P3>
-    Constraints.push_back(Constraint(Constraint::Copy, SIN,
+    addConstraint(Constraint(Constraint::Copy, SIN,
                                      getNode(SI.getOperand(1))));
-    Constraints.push_back(Constraint(Constraint::Copy, SIN,
+    addConstraint(Constraint(Constraint::Copy, SIN,
                                      getNode(SI.getOperand(2))));
   } else if (isa<StructType>(SI.getType())) {
     assert(dyn_cast<StructType>(SI.getType())->isLiteral());
@@ -1463,10 +2756,10 @@ void Andersens::visitSelectInst(SelectInst &SI) {
 
 void Andersens::AddConstraintForStruct(Value *V) {
   if (isa<IntegerType>(V->getType())) {
-    Constraints.push_back(Constraint(Constraint::Copy, AggregateNode,
+    addConstraint(Constraint(Constraint::Copy, AggregateNode,
           IntNode));
   } else if (isa<PointerType>(V->getType())) {
-    Constraints.push_back(Constraint(Constraint::Copy, AggregateNode,
+    addConstraint(Constraint(Constraint::Copy, AggregateNode,
           getNode(V)));
   } else if (isa<StructType>(V->getType())
           && dyn_cast<StructType>(V->getType())->isLiteral()) {
@@ -1480,7 +2773,7 @@ void Andersens::AddConstraintForConstantPointer(Value *V) {
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(*UI)) {
       if (CE->getOpcode() == Instruction::PtrToInt) {
         DEBUG(errs() << V->getName() << " has been converted to int.\n");
-        Constraints.push_back(Constraint(Constraint::Copy, IntNode, getNode(V)));
+        addConstraint(Constraint(Constraint::Copy, IntNode, getNode(V)));
         break;
       }
     }
@@ -1509,24 +2802,24 @@ void Andersens::AddConstraintsForCall(CallSite CS, Function *F) {
     unsigned CSN = getNode(CS.getInstruction());
     if (!F || isa<PointerType>(F->getFunctionType()->getReturnType())) {
       if (IsDeref)
-        Constraints.push_back(Constraint(Constraint::Load, CSN,
+        addConstraint(Constraint(Constraint::Load, CSN,
                                          getNode(CallValue), CallReturnPos));
       else
-        Constraints.push_back(Constraint(Constraint::Copy, CSN,
+        addConstraint(Constraint(Constraint::Copy, CSN,
                                          getNode(CallValue) + CallReturnPos));
     } else {
       // If the function returns a non-pointer value, handle this just like we
       // treat a nonpointer cast to pointer.
-      Constraints.push_back(Constraint(Constraint::Copy, CSN,
+      addConstraint(Constraint(Constraint::Copy, CSN,
                                        UniversalSet));
     }
   } else if (F && isa<PointerType>(F->getFunctionType()->getReturnType())) {
 #if FULL_UNIVERSAL
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
                                      UniversalSet,
                                      getNode(CallValue) + CallReturnPos));
 #else
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
                                      getNode(CallValue) + CallReturnPos,
                                      UniversalSet));
 #endif
@@ -1547,7 +2840,7 @@ void Andersens::AddConstraintsForCall(CallSite CS, Function *F) {
         // Add constraint that ArgI can now point to anything due to
         // escaping, as can everything it points to. The second portion of
         // this should be taken care of by universal = *universal
-        Constraints.push_back(Constraint(Constraint::Copy,
+        addConstraint(Constraint(Constraint::Copy,
                                          getNode(*ArgI),
                                          UniversalSet));
       }
@@ -1555,19 +2848,19 @@ void Andersens::AddConstraintsForCall(CallSite CS, Function *F) {
       if (isa<PointerType>(AI->getType())) {
         if (isa<PointerType>((*ArgI)->getType())) {
           // Copy the actual argument into the formal argument.
-          Constraints.push_back(Constraint(Constraint::Copy, getNode(AI),
+          addConstraint(Constraint(Constraint::Copy, getNode(AI),
                                            getNode(*ArgI)));
         } else {
-          Constraints.push_back(Constraint(Constraint::Copy, getNode(AI),
+          addConstraint(Constraint(Constraint::Copy, getNode(AI),
                                            UniversalSet));
         }
       } else if (isa<PointerType>((*ArgI)->getType())) {
 #if FULL_UNIVERSAL
-        Constraints.push_back(Constraint(Constraint::Copy,
+        addConstraint(Constraint(Constraint::Copy,
                                          UniversalSet,
                                          getNode(*ArgI)));
 #else
-        Constraints.push_back(Constraint(Constraint::Copy,
+        addConstraint(Constraint(Constraint::Copy,
                                          getNode(*ArgI),
                                          UniversalSet));
 #endif
@@ -1579,11 +2872,11 @@ void Andersens::AddConstraintsForCall(CallSite CS, Function *F) {
     for (; ArgI != ArgE; ++ArgI) {
       if (isa<PointerType>((*ArgI)->getType())) {
         // Copy the actual argument into the formal argument.
-        Constraints.push_back(Constraint(Constraint::Store,
+        addConstraint(Constraint(Constraint::Store,
                                          getNode(CallValue),
                                          getNode(*ArgI), ArgPos++));
       } else {
-        Constraints.push_back(Constraint(Constraint::Store,
+        addConstraint(Constraint(Constraint::Store,
                                          getNode (CallValue),
                                          UniversalSet, ArgPos++));
       }
@@ -1593,7 +2886,7 @@ void Andersens::AddConstraintsForCall(CallSite CS, Function *F) {
   if (F && F->getFunctionType()->isVarArg())
     for (; ArgI != ArgE; ++ArgI)
       if (isa<PointerType>((*ArgI)->getType()))
-        Constraints.push_back(Constraint(Constraint::Copy, getVarargNode(F),
+        addConstraint(Constraint(Constraint::Copy, getVarargNode(F),
                                          getNode(*ArgI)));
   // If more arguments are passed in than we track, just drop them on the floor.
 }
@@ -1604,7 +2897,7 @@ void Andersens::visitCallSite(CallSite CS) {
     if (isMallocCall(II)) {
       unsigned ObjectIndex = getObject(II);
       GraphNodes[ObjectIndex].setValue(II);
-      Constraints.push_back(Constraint(Constraint::AddressOf,
+      addConstraint(Constraint(Constraint::AddressOf,
                                        getNodeValue(*II),
                                        ObjectIndex));
       // Follow the same logic as AllocaInst.
@@ -1624,31 +2917,31 @@ void Andersens::visitCallSite(CallSite CS) {
 }
 
 void Andersens::visitIntToPtrInst(IntToPtrInst &I) {
-  Constraints.push_back(Constraint(Constraint::Copy,
+  addConstraint(Constraint(Constraint::Copy,
         getNodeValue(I), IntNode));
 }
 
 void Andersens::visitPtrToIntInst(PtrToIntInst &I) {
-  Constraints.push_back(Constraint(Constraint::Copy,
+  addConstraint(Constraint(Constraint::Copy,
         IntNode, getNode(I.getOperand(0))));
 }
 
 void Andersens::visitExtractValue(ExtractValueInst &I) {
   if (isa<PointerType>(I.getType()))
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
           getNodeValue(I), AggregateNode));
   else if (isa<IntegerType>(I.getType()))
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
           IntNode, AggregateNode));
 }
 
 void Andersens::visitInsertValue(InsertValueInst &I) {
   if (isa<PointerType>(I.getOperand(1)->getType())) {
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
           AggregateNode, getNode(I.getOperand(1))));
   }
   else if (isa<IntegerType>(I.getOperand(1)->getType()))
-    Constraints.push_back(Constraint(Constraint::Copy,
+    addConstraint(Constraint(Constraint::Copy,
           AggregateNode, IntNode));
 }
 
@@ -1659,28 +2952,14 @@ void Andersens::visitInsertValue(InsertValueInst &I) {
 /// intersects - Return true if the points-to set of this node intersects
 /// with the points-to set of the specified node.
 bool Andersens::Node::intersects(Node *N) const {
-  return PointsTo->intersects(N->PointsTo);
+  return PointsTo->intersects(*N->PointsTo);
 }
 
 /// intersectsIgnoring - Return true if the points-to set of this node
 /// intersects with the points-to set of the specified node on any nodes
 /// except for the specified node to ignore.
 bool Andersens::Node::intersectsIgnoring(Node *N, unsigned Ignoring) const {
-  // TODO: If we are only going to call this with the same value for Ignoring,
-  // we should move the special values out of the points-to bitmap.
-  bool WeHadIt = PointsTo->test(Ignoring);
-  bool NHadIt = N->PointsTo->test(Ignoring);
-  bool Result = false;
-  if (WeHadIt)
-    PointsTo->reset(Ignoring);
-  if (NHadIt)
-    N->PointsTo->reset(Ignoring);
-  Result = PointsTo->intersects(N->PointsTo);
-  if (WeHadIt)
-    PointsTo->set(Ignoring);
-  if (NHadIt)
-    N->PointsTo->set(Ignoring);
-  return Result;
+  return PointsTo->intersectsIgnoring(*N->PointsTo, Ignoring);
 }
 
 
@@ -1721,13 +3000,14 @@ void Andersens::ClumpAddressTaken() {
     }
   }
 
-  for (unsigned i = NumberSpecialNodes; i < GraphNodes.size(); ++i) {
-    if (!GraphNodes[i].AddressTaken) {
-      unsigned Pos = NewPos++;
-      Translate[i] = Pos;
-      NewGraphNodes.push_back(GraphNodes[i]);
-      DEBUG(errs() << "Renumbering node " << i << " to node " << Pos << "\n");
-    }
+  std::vector<unsigned> Order;
+  OrderUnaddressedNodes(Order);
+  for (unsigned j = 0; j < Order.size(); ++j) {
+    unsigned i = Order[j];
+    unsigned Pos = NewPos++;
+    Translate[i] = Pos;
+    NewGraphNodes.push_back(GraphNodes[i]);
+    DEBUG(errs() << "Renumbering node " << i << " to node " << Pos << "\n");
   }
 
   for (DenseMap<Value*, unsigned>::iterator Iter = ValueNodes.begin();
@@ -1766,11 +3046,108 @@ void Andersens::ClumpAddressTaken() {
   AggregateNode = Translate[AggregateNode];
   PthreadSpecificNode = Translate[PthreadSpecificNode];
 
+  if (!NodeKeys.empty()) {
+    std::vector<std::string> NewNodeKeys(NodeKeys.size());
+    for (unsigned i = 0; i < NodeKeys.size(); ++i)
+      NewNodeKeys[Translate[i]].swap(NodeKeys[i]);
+    NodeKeys.swap(NewNodeKeys);
+    Renumbering.swap(Translate);
+  }
+
   GraphNodes.swap(NewGraphNodes);
 #undef DEBUG_TYPE
 #define DEBUG_TYPE "anders-aa"
 }
 
+/// OrderUnaddressedNodes - List the nodes that are neither special nor address
+/// taken in the order ClumpAddressTaken places them.  With -anders-renumber,
+/// nodes joined by copy constraints end up next to each other, so that
+/// propagating along copy edges touches nearby nodes.  Address taken nodes
+/// keep their order, because objects with fields must stay contiguous.
+void Andersens::OrderUnaddressedNodes(std::vector<unsigned> &Order) {
+  unsigned Size = GraphNodes.size();
+  Order.clear();
+  if (Renumber == NoRenumber) {
+    for (unsigned i = NumberSpecialNodes; i < Size; ++i) {
+      if (!GraphNodes[i].AddressTaken)
+        Order.push_back(i);
+    }
+    return;
+  }
+
+  // The copy constraints in CSR form.
+  std::vector<unsigned> SuccBegin(Size + 1, 0), Succs;
+  std::vector<unsigned> NumPreds(Size, 0);
+  for (unsigned i = 0; i < Constraints.size(); ++i) {
+    const Constraint &C = Constraints[i];
+    if (C.Type == Constraint::Copy) {
+      ++SuccBegin[C.Src + 1];
+      ++NumPreds[C.Dest];
+    }
+  }
+  for (unsigned i = 0; i < Size; ++i)
+    SuccBegin[i + 1] += SuccBegin[i];
+  Succs.resize(SuccBegin[Size]);
+  std::vector<unsigned> Fill(SuccBegin.begin(), SuccBegin.end() - 1);
+  for (unsigned i = 0; i < Constraints.size(); ++i) {
+    const Constraint &C = Constraints[i];
+    if (C.Type == Constraint::Copy)
+      Succs[Fill[C.Src]++] = C.Dest;
+  }
+
+  // Special and address taken nodes are already placed.
+  std::vector<bool> Visited(Size, false);
+  for (unsigned i = 0; i < Size; ++i) {
+    if (i < NumberSpecialNodes || GraphNodes[i].AddressTaken)
+      Visited[i] = true;
+  }
+
+  if (Renumber == BFSRenumber) {
+    // Order doubles as the queue.
+    for (unsigned i = NumberSpecialNodes; i < Size; ++i) {
+      if (Visited[i])
+        continue;
+      Visited[i] = true;
+      Order.push_back(i);
+      for (unsigned Head = Order.size() - 1; Head < Order.size(); ++Head) {
+        unsigned N = Order[Head];
+        for (unsigned j = SuccBegin[N]; j < SuccBegin[N + 1]; ++j) {
+          if (!Visited[Succs[j]]) {
+            Visited[Succs[j]] = true;
+            Order.push_back(Succs[j]);
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  // Reverse post-order, starting from the nodes without predecessors.
+  std::vector<std::pair<unsigned, unsigned> > Stack;
+  for (unsigned Pass = 0; Pass < 2; ++Pass) {
+    for (unsigned i = NumberSpecialNodes; i < Size; ++i) {
+      if (Visited[i] || (Pass == 0 && NumPreds[i] > 0))
+        continue;
+      Visited[i] = true;
+      Stack.push_back(std::make_pair(i, SuccBegin[i]));
+      while (!Stack.empty()) {
+        unsigned N = Stack.back().first;
+        if (Stack.back().second < SuccBegin[N + 1]) {
+          unsigned Succ = Succs[Stack.back().second++];
+          if (!Visited[Succ]) {
+            Visited[Succ] = true;
+            Stack.push_back(std::make_pair(Succ, SuccBegin[Succ]));
+          }
+        } else {
+          Order.push_back(N);
+          Stack.pop_back();
+        }
+      }
+    }
+  }
+  std::reverse(Order.begin(), Order.end());
+}
+
 /// The technique used here is described in "Exploiting Pointer and Location
 /// Equivalence to Optimize Pointer Analysis. In the 14th International Static
 /// Analysis Symposium (SAS), August 2007."  It is known as the "HVN" algorithm,
@@ -1808,6 +3185,7 @@ void Andersens::ClumpAddressTaken() {
 /// receive &D from E anyway.
 
 void Andersens::HVN() {
+  PhaseScope Phase(*this, "HVN");
   errs() << "Beginning HVN\n";
   DEBUG(PrintConstraints());
   // Build a predecessor graph.  This is like our constraint graph with the
@@ -1957,7 +3335,7 @@ void Andersens::HVNValNum(unsigned NodeIndex) {
     // Collect labels of successor nodes
     bool AllSame = true;
     unsigned First = ~0;
-    SparseBitVector<> *Labels = new SparseBitVector<>;
+    rcs::HybridBitSet *Labels = new rcs::HybridBitSet;
     bool Used = false;
 
     if (N->PredEdges)
@@ -2004,6 +3382,7 @@ void Andersens::HVNValNum(unsigned NodeIndex) {
 /// and is equivalent to value numbering the collapsed constraint graph
 /// including evaluating unions.
 void Andersens::HU() {
+  PhaseScope Phase(*this, "HU");
   errs() << "Beginning HU\n";
   DEBUG(PrintConstraints());
   // Build a predecessor graph.  This is like our constraint graph with the
@@ -2137,7 +3516,7 @@ void Andersens::Condense(unsigned NodeIndex) {
       // Unify the nodes
       N->Direct &= CycleNode->Direct;
 
-      *(N->PointsTo) |= CycleNode->PointsTo;
+      *N->PointsTo |= *CycleNode->PointsTo;
       delete CycleNode->PointsTo;
       CycleNode->PointsTo = NULL;
       if (CycleNode->PredEdges) {
@@ -2207,7 +3586,7 @@ void Andersens::HUValNum(unsigned NodeIndex) {
         continue;
       }
 
-      *(N->PointsTo) |= GraphNodes[j].PointsTo;
+      *N->PointsTo |= *GraphNodes[j].PointsTo;
 
       // If we didn't end up storing this in the hash, and we're done with all
       // the edges, we don't need the points-to set anymore.
@@ -2246,6 +3625,7 @@ void Andersens::HUValNum(unsigned NodeIndex) {
 /// Rewrite our list of constraints so that pointer equivalent nodes are
 /// replaced by their the pointer equivalence class representative.
 void Andersens::RewriteConstraints() {
+  PhaseScope Phase(*this, "RewriteConstraints");
   std::vector<Constraint> NewConstraints;
   DenseSet<Constraint, ConstraintKeyInfo> Seen;
 
@@ -2348,6 +3728,7 @@ void Andersens::PrintLabels() const {
 /// operation are stored in SDT and are later used in SolveContraints()
 /// and UniteNodes().
 void Andersens::HCD() {
+  PhaseScope Phase(*this, "HCD");
   errs() << "Starting HCD.\n";
   HCDSCCRep.resize(GraphNodes.size());
 
@@ -2469,6 +3850,7 @@ void Andersens::Search(unsigned Node) {
 /// Optimize the constraints by performing offline variable substitution and
 /// other optimizations.
 void Andersens::OptimizeConstraints() {
+  PhaseScope Phase(*this, "OptimizeConstraints");
   errs() << "Beginning constraint optimization\n";
 
   SDTActive = false;
@@ -2516,7 +3898,7 @@ void Andersens::OptimizeConstraints() {
   for (unsigned i = 0; i < GraphNodes.size(); ++i) {
     Node *N = &GraphNodes[i];
     if (FindNode(i) == i) {
-      N->PointsTo = new SparseBitVector<>;
+      N->PointsTo = new rcs::HybridBitSet;
       N->PointedToBy = new SparseBitVector<>;
       // Reset our labels
     }
@@ -2561,6 +3943,7 @@ void Andersens::OptimizeConstraints() {
 /// Unite pointer but not location equivalent variables, now that the constraint
 /// graph is built.
 void Andersens::UnitePointerEquivalences() {
+  PhaseScope Phase(*this, "UnitePointerEquivalences");
   DEBUG(errs() << "Uniting remaining pointer equivalences\n");
   for (unsigned i = 0; i < GraphNodes.size(); ++i) {
     if (GraphNodes[i].AddressTaken && GraphNodes[i].isRep()) {
@@ -2577,6 +3960,7 @@ void Andersens::UnitePointerEquivalences() {
 /// Create the constraint graph used for solving points-to analysis.
 ///
 void Andersens::CreateConstraintGraph() {
+  PhaseScope Phase(*this, "CreateConstraintGraph");
   for (unsigned i = 0, e = Constraints.size(); i != e; ++i) {
     Constraint &C = Constraints[i];
     assert (C.Src < GraphNodes.size() && C.Dest < GraphNodes.size());
@@ -2659,27 +4043,11 @@ bool Andersens::QueryNode(unsigned Node) {
   return(Changed | Merged);
 }
 
-/// SolveConstraints - This stage iteratively processes the constraints list
-/// propagating constraints (adding edges to the Nodes in the points-to graph)
-/// until a fixed point is reached.
-///
-/// We use a variant of the technique called "Lazy Cycle Detection", which is
-/// described in "The Ant and the Grasshopper: Fast and Accurate Pointer
-/// Analysis for Millions of Lines of Code. In Programming Language Design and
-/// Implementation (PLDI), June 2007."
-/// The paper describes performing cycle detection one node at a time, which can
-/// be expensive if there are no cycles, but there are long chains of nodes that
-/// it heuristically believes are cycles (because it will DFS from each node
-/// without state from previous nodes).
-/// Instead, we use the heuristic to build a worklist of nodes to check, then
-/// cycle detect them all at the same time to do this more cheaply.  This
-/// catches cycles slightly later than the original technique did, but does it
-/// make significantly cheaper.
-
+/// SolveConstraints - This stage builds the constraint graph out of the
+/// optimized constraints and propagates the points-to sets along it until a
+/// fixed point is reached.
 void Andersens::SolveConstraints() {
-  CurrWL = &w1;
-  NextWL = &w2;
-
+  PhaseScope Phase(*this, "SolveConstraints");
   OptimizeConstraints();
 #undef DEBUG_TYPE
 #define DEBUG_TYPE "anders-aa-constraints"
@@ -2687,23 +4055,213 @@ void Andersens::SolveConstraints() {
 #undef DEBUG_TYPE
 #define DEBUG_TYPE "anders-aa"
 
+  CreateSolverGraph();
+  UnitePointerEquivalences();
+  if (BenchmarkWorkLists)
+    RunWorkListBenchmark();
+  PropagateConstraints(AndersWorkList, AndersThreads);
+  FinishSolving();
+}
+
+/// CreateSolverGraph - Allocate the solver's sets and build the constraint
+/// graph in them.
+void Andersens::CreateSolverGraph() {
   for (unsigned i = 0; i < GraphNodes.size(); ++i) {
     Node *N = &GraphNodes[i];
-    N->PointsTo = new SparseBitVector<>;
-    N->OldPointsTo = new SparseBitVector<>;
+    N->PointsTo = new rcs::HybridBitSet;
+    N->OldPointsToSet = PointsToSetStore::EmptySet;
+    N->OldPointsTo = SetStore.getBitmap(N->OldPointsToSet);
     N->Edges = new SparseBitVector<>;
   }
   CreateConstraintGraph();
-  UnitePointerEquivalences();
+}
+
+/// PropagateConstraints - Run the solver on the constraint graph.  Nodes whose
+/// PointsTo differs from their OldPointsTo are the ones with work to do.
+/// Kind is the work list of the serial solver, which runs if NumThreads is 1.
+void Andersens::PropagateConstraints(WorkListKind Kind, unsigned NumThreads) {
+  PhaseScope Phase(*this, "PropagateConstraints");
   assert(SCCStack.empty() && "SCC Stack should be empty by now!");
   Node2DFS.clear();
   Node2Deleted.clear();
   Node2DFS.insert(Node2DFS.begin(), GraphNodes.size(), 0);
   Node2Deleted.insert(Node2Deleted.begin(), GraphNodes.size(), false);
   DFSNumber = 0;
+  if (NumThreads > 1)
+    SolveWithWavePropagation();
+  else
+    SolveWithLazyCycleDetection(Kind);
+}
+
+/// CreateWorkList - Create an empty work list of the given kind.
+Andersens::WorkList *Andersens::CreateWorkList(WorkListKind Kind) {
+  switch (Kind) {
+    case LRF:
+      return new LRFWorkList;
+    case FIFO:
+      return new FIFOWorkList;
+    case LIFO:
+      return new LIFOWorkList;
+    case Topo:
+      return new TopoWorkList(TopoOrder, &GraphNodes[0]);
+  }
+  llvm_unreachable("Unknown work list kind");
+}
+
+/// ComputeTopoOrder - Number the representatives in reverse post-order of the
+/// constraint graph, so that a node comes before its successors unless they
+/// are on a cycle that has not been collapsed yet.
+void Andersens::ComputeTopoOrder() {
+  unsigned Size = GraphNodes.size();
+  TopoOrder.assign(Size, ~0U);
+  std::vector<bool> Visited(Size, false);
+  std::vector<std::pair<unsigned, SparseBitVector<>::iterator> > Stack;
+  unsigned Next = Size;
+
+  for (unsigned i = 0; i < Size; ++i) {
+    if (!GraphNodes[i].isRep() || Visited[i])
+      continue;
+    Visited[i] = true;
+    Stack.push_back(std::make_pair(i, GraphNodes[i].Edges->begin()));
+    while (!Stack.empty()) {
+      unsigned N = Stack.back().first;
+      if (Stack.back().second != GraphNodes[N].Edges->end()) {
+        unsigned Succ = FindNode(*Stack.back().second);
+        ++Stack.back().second;
+        if (!Visited[Succ]) {
+          Visited[Succ] = true;
+          Stack.push_back(std::make_pair(Succ, GraphNodes[Succ].Edges->begin()));
+        }
+      } else {
+        TopoOrder[N] = --Next;
+        Stack.pop_back();
+      }
+    }
+  }
+}
+
+/// SaveSolverState - Copy the constraint graph as it is before propagation.
+void Andersens::SaveSolverState(SolverState &S) {
+  unsigned Size = GraphNodes.size();
+  S.NodeReps.resize(Size);
+  S.PointsTo.resize(Size);
+  S.Edges.resize(Size);
+  S.Constraints.resize(Size);
+  for (unsigned i = 0; i < Size; ++i) {
+    Node *N = &GraphNodes[i];
+    S.NodeReps[i] = N->NodeRep;
+    S.PointsTo[i] = N->PointsTo ? new rcs::HybridBitSet(*N->PointsTo) : NULL;
+    S.Edges[i] = N->Edges ? new SparseBitVector<>(*N->Edges) : NULL;
+    S.Constraints[i] = N->Constraints;
+  }
+  S.SDT = SDT;
+}
+
+/// RestoreSolverState - Put the constraint graph back the way SaveSolverState
+/// found it.
+void Andersens::RestoreSolverState(const SolverState &S) {
+  for (unsigned i = 0; i < GraphNodes.size(); ++i) {
+    Node *N = &GraphNodes[i];
+    if (N->OldPointsTo)
+      ClearOldPointsTo(N);
+    delete N->PointsTo;
+    delete N->Edges;
+    N->NodeRep = S.NodeReps[i];
+    N->PointsTo = S.PointsTo[i] ? new rcs::HybridBitSet(*S.PointsTo[i]) : NULL;
+    N->Edges = S.Edges[i] ? new SparseBitVector<>(*S.Edges[i]) : NULL;
+    N->Constraints = S.Constraints[i];
+    N->OldPointsToSet = PointsToSetStore::EmptySet;
+    N->OldPointsTo = N->PointsTo ? SetStore.getBitmap(N->OldPointsToSet) : NULL;
+  }
+  SDT = S.SDT;
+}
+
+/// RunWorkListBenchmark - Solve the constraint graph with each work list in
+/// turn and report how much work each did.  The graph is left as it was, for
+/// the real solver to run on.
+void Andersens::RunWorkListBenchmark() {
+  static const WorkListKind Kinds[] = { LRF, FIFO, LIFO, Topo };
+  static const char *const Names[] = { "lrf", "fifo", "lifo", "topo" };
+
+  SolverState S;
+  SaveSolverState(S);
+  errs() << "Work list  Iterations  Node visits  Wall time (s)\n";
+  for (unsigned k = 0; k < array_lengthof(Kinds); ++k) {
+    TimeRecord Start = TimeRecord::getCurrentTime(true);
+    PropagateConstraints(Kinds[k], 1);
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+    errs() << format("%-9s  %10u  %11u  %13.3f\n", Names[k],
+                     SolverIterations, SolverVisits,
+                     End.getWallTime() - Start.getWallTime());
+    RestoreSolverState(S);
+  }
+}
+
+/// FinishSolving - Free what the solver no longer needs, and keep the final
+/// points-to sets in SetStore.
+void Andersens::FinishSolving() {
+  PhaseScope Phase(*this, "FinishSolving");
+  Node2DFS.clear();
+  Node2Deleted.clear();
+  SDTActive = false;
+  SDT.clear();
+  ClearAliasCache();
+  StorePointees.clear();
+  SetStore.flushReleases();
+
+  // The points-to sets are only read from now on.  Many representatives end
+  // up with identical sets, so keep one copy of each, in shard 0.  A node
+  // whose set has not changed since the solver last processed it already
+  // shares it with SetStore.
+  for (unsigned i = 0; i < GraphNodes.size(); ++i) {
+    Node *N = &GraphNodes[i];
+    // The PhaseScope above counts the edges on its way out.
+    delete N->Edges;
+    N->Edges = NULL;
+    if (N->PointsTo && N->PointsTo == N->OldPointsTo &&
+        PointsToSetStore::getShard(N->OldPointsToSet) == 0) {
+      N->PointsToSet = N->OldPointsToSet;
+    } else {
+      if (N->PointsTo) {
+        N->PointsToSet = SetStore.intern(*N->PointsTo);
+        FreePointsTo(N);
+        N->PointsTo = SetStore.getBitmap(N->PointsToSet);
+      }
+      SetStore.release(N->OldPointsToSet);
+    }
+    N->OldPointsToSet = PointsToSetStore::EmptySet;
+    N->OldPointsTo = NULL;
+  }
+  NumPointsToSets = SetStore.getNumSets();
+}
+
+/// SolveWithLazyCycleDetection - Iteratively process the constraints list
+/// propagating constraints (adding edges to the Nodes in the points-to graph)
+/// until a fixed point is reached.
+///
+/// We use a variant of the technique called "Lazy Cycle Detection", which is
+/// described in "The Ant and the Grasshopper: Fast and Accurate Pointer
+/// Analysis for Millions of Lines of Code. In Programming Language Design and
+/// Implementation (PLDI), June 2007."
+/// The paper describes performing cycle detection one node at a time, which can
+/// be expensive if there are no cycles, but there are long chains of nodes that
+/// it heuristically believes are cycles (because it will DFS from each node
+/// without state from previous nodes).
+/// Instead, we use the heuristic to build a worklist of nodes to check, then
+/// cycle detect them all at the same time to do this more cheaply.  This
+/// catches cycles slightly later than the original technique did, but does it
+/// make significantly cheaper.
+void Andersens::SolveWithLazyCycleDetection(WorkListKind Kind) {
   DenseSet<Constraint, ConstraintKeyInfo> Seen;
   DenseSet<std::pair<unsigned,unsigned>, PairKeyInfo> EdgesChecked;
 
+  w1.reset(CreateWorkList(Kind));
+  w2.reset(CreateWorkList(Kind));
+  CurrWL = w1.get();
+  NextWL = w2.get();
+  SolverIterations = 0;
+  SolverVisits = 0;
+
   // Order graph and add initial nodes to work list.
   for (unsigned i = 0; i < GraphNodes.size(); ++i) {
     Node *INode = &GraphNodes[i];
@@ -2726,7 +4284,10 @@ void Andersens::SolveConstraints() {
   std::vector<unsigned int> RSV;
 #endif
   while( !CurrWL->empty() ) {
-    errs() << "Starting iteration #" << ++NumIters << "\n";
+    ++NumIters;
+    DEBUG(errs() << "Starting iteration #" << NumIters << "\n");
+    ++SolverIterations;
+    RecordIteration("lcd", SolverIterations, CurrWL->size());
 
     Node* CurrNode;
     unsigned CurrNodeIndex;
@@ -2748,21 +4309,26 @@ void Andersens::SolveConstraints() {
       }
     }
 
+    if (Kind == Topo)
+      ComputeTopoOrder();
+
     // Add to work list if it's a representative and can contribute to the
     // calculation right now.
     while( (CurrNode = CurrWL->pop()) != NULL ) {
       CurrNodeIndex = CurrNode - &GraphNodes[0];
       CurrNode->Stamp();
+      ++NumNodeVisits;
+      ++SolverVisits;
 
 
       // Figure out the changed points to bits
-      SparseBitVector<> CurrPointsTo;
-      CurrPointsTo.intersectWithComplement(CurrNode->PointsTo,
-                                           CurrNode->OldPointsTo);
+      rcs::HybridBitSet CurrPointsTo;
+      CurrPointsTo.intersectWithComplement(*CurrNode->PointsTo,
+                                           *CurrNode->OldPointsTo);
       if (CurrPointsTo.empty())
         continue;
 
-      *(CurrNode->OldPointsTo) |= CurrPointsTo;
+      UpdateOldPointsTo(CurrNode);
 
       // Check the offline-computed equivalencies from HCD.
       bool SCC = false;
@@ -2775,7 +4341,7 @@ void Andersens::SolveConstraints() {
 #if !FULL_UNIVERSAL
         RSV.clear();
 #endif
-        for (SparseBitVector<>::iterator bi = CurrPointsTo.begin();
+        for (rcs::HybridBitSet::iterator bi = CurrPointsTo.begin();
              bi != CurrPointsTo.end(); ++bi) {
           unsigned Node = FindNode(*bi);
 #if !FULL_UNIVERSAL
@@ -2847,7 +4413,7 @@ void Andersens::SolveConstraints() {
           CurrMember = Rep;
 
           if (GraphNodes[*Src].Edges->test_and_set(*Dest))
-            if (GraphNodes[*Dest].PointsTo |= *(GraphNodes[*Src].PointsTo))
+            if (UnionPointsTo(&GraphNodes[*Dest], *GraphNodes[*Src].PointsTo))
               NextWL->insert(&GraphNodes[*Dest]);
 #else
           for (unsigned i=0; i < RSV.size(); ++i) {
@@ -2856,7 +4422,8 @@ void Andersens::SolveConstraints() {
             if (*Dest < NumberSpecialNodes)
               continue;
             if (GraphNodes[*Src].Edges->test_and_set(*Dest))
-              if ((GraphNodes[*Dest].PointsTo |= *(GraphNodes[*Src].PointsTo)))
+              if (UnionPointsTo(&GraphNodes[*Dest],
+                                *GraphNodes[*Src].PointsTo))
                 NextWL->insert(&GraphNodes[*Dest]);
           }
 #endif
@@ -2876,54 +4443,17 @@ void Andersens::SolveConstraints() {
 #endif
             GraphNodes[CurrNodeIndex].Constraints.erase(lk);
         } else {
-          const SparseBitVector<> &Solution = CurrPointsTo;
+          const rcs::HybridBitSet &Solution = CurrPointsTo;
 
-          for (SparseBitVector<>::iterator bi = Solution.begin();
+          for (rcs::HybridBitSet::iterator bi = Solution.begin();
                bi != Solution.end();
                ++bi) {
-            CurrMember = *bi;
-            K = li->Offset;
-
-            // Need to increment the member by K since that is where we are
-            // supposed to copy to/from.  Note that in positive weight cycles,
-            // which occur in address taking of fields, K can go past
-            // MaxK[CurrMember] elements, even though that is all it could point
-            // to.
-            if (K > 0) {
-              Value *V = GraphNodes[CurrMember].getValue();
-              if (V) {
-                Function *F = dyn_cast<Function>(V);
-                if (F) {
-                  DEBUG(PrintConstraint(*li));
-                  DEBUG(errs() << "For " << CurrMember << ", should look at: " << getNode(F) << ", K = " << K << "\n");
-                  CurrMember = getNode(F);
-                  if (K >= CallFirstArgPos) {
-                    int NArg = K - CallFirstArgPos;
-                    if (ReturnNodes.find(F) == ReturnNodes.end()) {
-                      // no return node: minus one
-                      K--;
-                    }
-                    if (VarargNodes.find(F) != VarargNodes.find(F)) {
-                      // has vararg node: plus one
-                      K++;
-                    }
-                    Function::arg_iterator AI = F->arg_begin();
-                    for (int i=0; i<NArg; i++, AI++) {
-                      if (!isa<PointerType>(AI->getType())) K--;
-                    }
-                    DEBUG(errs() << "    new K: " << K << "\n");
-                  }
-                }
-              }
-            }
-
-            if (K > 0 && K > MaxK[CurrMember]) {
+            unsigned Target;
+            if (!getOffsetMember(*bi, li->Offset, Target))
               continue;
-            } else {
-              CurrMember = FindNode(CurrMember + K);
-              if (K > 0)
-                DEBUG(errs() << "Src: " << *Src << " dst: " << *Dest << "\n");
-            }
+            CurrMember = FindNode(Target);
+            if (li->Offset > 0)
+              DEBUG(errs() << "Src: " << *Src << " dst: " << *Dest << "\n");
 
             // Add an edge to the graph, so we can just do regular
             // bitmap ior next time.  It may also let us notice a cycle.
@@ -2932,7 +4462,8 @@ void Andersens::SolveConstraints() {
               continue;
 #endif
             if (GraphNodes[*Src].Edges->test_and_set(*Dest))
-              if ((GraphNodes[*Dest].PointsTo |= *(GraphNodes[*Src].PointsTo)))
+              if (UnionPointsTo(&GraphNodes[*Dest],
+                                *GraphNodes[*Src].PointsTo))
                 NextWL->insert(&GraphNodes[*Dest]);
 
           }
@@ -2974,7 +4505,7 @@ void Andersens::SolveConstraints() {
 #if !FULL_UNIVERSAL
         if (Rep >= NumberSpecialNodes)
 #endif
-          if ((GraphNodes[Rep].PointsTo |= CurrPointsTo)) {
+          if (UnionPointsTo(&GraphNodes[Rep], CurrPointsTo)) {
             NextWL->insert(&GraphNodes[Rep]);
           }
         // If this edge's destination was collapsed, rewrite the edge.
@@ -2991,39 +4522,1544 @@ void Andersens::SolveConstraints() {
     WorkList* t = CurrWL; CurrWL = NextWL; NextWL = t;
   }
 
+}
 
-  Node2DFS.clear();
-  Node2Deleted.clear();
-  for (unsigned i = 0; i < GraphNodes.size(); ++i) {
+/// RunBitSetBenchmark - Run the set operations of the solver and the alias
+/// queries on pairs of solved points-to sets, once on SparseBitVectors and
+/// once on HybridBitSets, and report the time of each.
+void Andersens::RunBitSetBenchmark() {
+  static const unsigned MaxSets = 1000;
+  std::vector<SparseBitVector<> > Sparse;
+  std::vector<const rcs::HybridBitSet *> Hybrid;
+  DenseSet<unsigned> Seen;
+  for (unsigned i = 0; i < GraphNodes.size() && Hybrid.size() < MaxSets; ++i) {
     Node *N = &GraphNodes[i];
-    delete N->OldPointsTo;
-    delete N->Edges;
+    if (!N->isRep() || !N->PointsTo || N->PointsTo->empty() ||
+        !Seen.insert(N->PointsToSet).second)
+      continue;
+    Hybrid.push_back(N->PointsTo);
+    Sparse.push_back(SparseBitVector<>());
+    for (rcs::HybridBitSet::iterator bi = N->PointsTo->begin();
+         bi != N->PointsTo->end(); ++bi)
+      Sparse.back().set(*bi);
   }
-  SDTActive = false;
-  SDT.clear();
+  unsigned NumSets = Hybrid.size();
+  if (NumSets == 0) {
+    errs() << "No points-to sets to benchmark\n";
+    return;
+  }
+  unsigned NumForms[3] = { 0, 0, 0 };
+  for (unsigned i = 0; i < NumSets; ++i)
+    ++NumForms[Hybrid[i]->getForm()];
+  errs() << NumSets << " sets: " << NumForms[rcs::HybridBitSet::Array]
+      << " arrays, " << NumForms[rcs::HybridBitSet::Chunked] << " chunked, "
+      << NumForms[rcs::HybridBitSet::Dense] << " dense\n";
+
+  // Every pair, up to about a million of them.
+  unsigned Stride = 1;
+  while ((uint64_t)NumSets * NumSets / (Stride * Stride) > 1000000)
+    ++Stride;
+  errs() << "Operation        SparseBitVector (s)  HybridBitSet (s)\n";
+  for (unsigned Op = 0; Op < 3; ++Op) {
+    static const char *const Names[] = { "union", "difference", "intersects" };
+    unsigned SparseCount = 0, HybridCount = 0;
+
+    TimeRecord Start = TimeRecord::getCurrentTime(true);
+    for (unsigned i = 0; i < NumSets; i += Stride) {
+      for (unsigned j = 0; j < NumSets; j += Stride) {
+        if (Op == 0) {
+          SparseBitVector<> Result(Sparse[i]);
+          Result |= Sparse[j];
+          SparseCount += Result.count();
+        } else if (Op == 1) {
+          SparseBitVector<> Result;
+          Result.intersectWithComplement(Sparse[i], Sparse[j]);
+          SparseCount += Result.count();
+        } else {
+          // The way alias queries used to test for a common object.
+          SparseBitVector<> Common(Sparse[i]);
+          Common &= Sparse[j];
+          Common.reset(NullObject);
+          SparseCount += !Common.empty();
+        }
+      }
+    }
+    TimeRecord Middle = TimeRecord::getCurrentTime(false);
+    for (unsigned i = 0; i < NumSets; i += Stride) {
+      for (unsigned j = 0; j < NumSets; j += Stride) {
+        if (Op == 0) {
+          rcs::HybridBitSet Result(*Hybrid[i]);
+          Result |= *Hybrid[j];
+          HybridCount += Result.count();
+        } else if (Op == 1) {
+          rcs::HybridBitSet Result;
+          Result.intersectWithComplement(*Hybrid[i], *Hybrid[j]);
+          HybridCount += Result.count();
+        } else {
+          HybridCount += Hybrid[i]->intersectsIgnoring(*Hybrid[j], NullObject);
+        }
+      }
+    }
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+
+    errs() << format("%-15s  %19.3f  %16.3f\n", Names[Op],
+                     Middle.getWallTime() - Start.getWallTime(),
+                     End.getWallTime() - Middle.getWallTime());
+    if (SparseCount != HybridCount)
+      errs() << "  results differ: " << SparseCount << " vs " << HybridCount
+          << "\n";
+  }
+}
+
+/// getOffsetMember - Compute the node K fields past Member, the way complex
+/// constraints with an offset see it.  An offset into a function object is an
+/// offset into the function's return and argument nodes, adjusted for the
+/// nodes the function does not have.  Returns false if the offset goes past
+/// the end of the object.  Target is not necessarily a representative.
+bool Andersens::getOffsetMember(unsigned Member, unsigned K,
+                                unsigned &Target) const {
+  // Need to increment the member by K since that is where we are supposed to
+  // copy to/from.  Note that in positive weight cycles, which occur in address
+  // taking of fields, K can go past MaxK[Member] elements, even though that is
+  // all it could point to.
+  if (K > 0) {
+    Value *V = GraphNodes[Member].getValue();
+    if (V) {
+      Function *F = dyn_cast<Function>(V);
+      if (F) {
+        DEBUG(errs() << "For " << Member << ", should look at: " << getNode(F) << ", K = " << K << "\n");
+        Member = getNode(F);
+        if (K >= CallFirstArgPos) {
+          int NArg = K - CallFirstArgPos;
+          if (ReturnNodes.find(F) == ReturnNodes.end()) {
+            // no return node: minus one
+            K--;
+          }
+          if (VarargNodes.find(F) != VarargNodes.find(F)) {
+            // has vararg node: plus one
+            K++;
+          }
+          Function::arg_iterator AI = F->arg_begin();
+          for (int i=0; i<NArg; i++, AI++) {
+            if (!isa<PointerType>(AI->getType())) K--;
+          }
+          DEBUG(errs() << "    new K: " << K << "\n");
+        }
+      }
+    }
+  }
+
+  if (K > 0) {
+    std::map<unsigned, unsigned>::const_iterator I = MaxK.find(Member);
+    if (I == MaxK.end() || K > I->second)
+      return false;
+  }
+  Target = Member + K;
+  return true;
 }
 
 //===----------------------------------------------------------------------===//
-//                               Union-Find
+//                          Wave Propagation Solver
 //===----------------------------------------------------------------------===//
 
-// Unite nodes First and Second, returning the one which is now the
-// representative node.  First and Second are indexes into GraphNodes
-unsigned Andersens::UniteNodes(unsigned First, unsigned Second,
-                               bool UnionByRank) {
-  assert (First < GraphNodes.size() && Second < GraphNodes.size() &&
-          "Attempting to merge nodes that don't exist");
+// Pulls the new points-to bits of a node's predecessors into the node, and
+// computes the bits the node itself gained in this round.  All nodes handed
+// to one ParallelFor are on the same topological level, so they only read the
+// sets of lower levels and only write their own.  Each thread interns into
+// its own shard of SetStore.
+struct Andersens::WavePullBody {
+  Andersens &A;
+  const unsigned *Nodes;
+  const std::vector<unsigned> &PredBegin, &Preds;
+  const std::vector<unsigned> &FreshPredBegin, &FreshPreds;
+  std::vector<rcs::HybridBitSet *> &Delta;
+  // In the first wave, every node may have bits it has not propagated yet.
+  bool FirstWave;
+
+  WavePullBody(Andersens &A, const unsigned *Nodes,
+               const std::vector<unsigned> &PredBegin,
+               const std::vector<unsigned> &Preds,
+               const std::vector<unsigned> &FreshPredBegin,
+               const std::vector<unsigned> &FreshPreds,
+               std::vector<rcs::HybridBitSet *> &Delta, bool FirstWave):
+      A(A), Nodes(Nodes), PredBegin(PredBegin), Preds(Preds),
+      FreshPredBegin(FreshPredBegin), FreshPreds(FreshPreds), Delta(Delta),
+      FirstWave(FirstWave) {}
+
+  void operator()(size_t I, unsigned ThreadID) {
+    unsigned NodeIndex = Nodes[I];
+    Node *N = &A.GraphNodes[NodeIndex];
+
+    bool Changed = false;
+    for (unsigned j = PredBegin[NodeIndex]; j < PredBegin[NodeIndex + 1]; ++j) {
+      if (rcs::HybridBitSet *D = Delta[Preds[j]])
+        Changed |= A.UnionPointsTo(N, *D);
+    }
+    // Edges added by the last round have never carried anything.
+    for (unsigned j = FreshPredBegin[NodeIndex];
+         j < FreshPredBegin[NodeIndex + 1]; ++j) {
+      Changed |= A.UnionPointsTo(N, *A.GraphNodes[FreshPreds[j]].PointsTo);
+    }
+    // OldPointsTo is reset when the node absorbs a cycle.
+    if (!Changed && !FirstWave && !N->OldPointsTo->empty())
+      return;
 
-  Node *FirstNode = &GraphNodes[First];
-  Node *SecondNode = &GraphNodes[Second];
+    rcs::HybridBitSet *D = new rcs::HybridBitSet;
+    D->intersectWithComplement(*N->PointsTo, *N->OldPointsTo);
+    if (D->empty()) {
+      delete D;
+      return;
+    }
+    A.UpdateOldPointsTo(N, ThreadID);
+    Delta[NodeIndex] = D;
+  }
+};
 
-  assert (SecondNode->isRep() && FirstNode->isRep() &&
-          "Trying to unite two non-representative nodes!");
-  if (First == Second)
-    return First;
+// A copy edge produced by phase 3, tagged with the index of the node whose
+// constraints produced it.
+struct WaveEdge {
+  unsigned Site, Src, Dest;
 
-  if (UnionByRank) {
-    int RankFirst  = (int) FirstNode ->NodeRep;
+  WaveEdge(unsigned Site, unsigned Src, unsigned Dest):
+      Site(Site), Src(Src), Dest(Dest) {}
+
+  bool operator<(const WaveEdge &RHS) const { return Site < RHS.Site; }
+};
+
+// Resolves the load and store constraints of a node against the points-to
+// bits it gained in this round.  The copy edges these constraints imply are
+// collected into per-thread buffers, and added to the graph afterwards.
+struct Andersens::WaveResolveBody {
+  const Andersens &A;
+  const std::vector<unsigned> &Nodes;
+  const std::vector<rcs::HybridBitSet *> &Delta;
+  std::vector<std::vector<WaveEdge> > &NewEdges;
+
+  WaveResolveBody(const Andersens &A, const std::vector<unsigned> &Nodes,
+                  const std::vector<rcs::HybridBitSet *> &Delta,
+                  std::vector<std::vector<WaveEdge> > &NewEdges):
+      A(A), Nodes(Nodes), Delta(Delta), NewEdges(NewEdges) {}
+
+  void operator()(size_t I, unsigned ThreadID) {
+    unsigned NodeIndex = Nodes[I];
+    const rcs::HybridBitSet &Solution = *Delta[NodeIndex];
+    const std::list<Constraint> &Cs = A.GraphNodes[NodeIndex].Constraints;
+    for (std::list<Constraint>::const_iterator li = Cs.begin();
+         li != Cs.end(); ++li) {
+      if (li->Type != Constraint::Load && li->Type != Constraint::Store)
+        continue;
+      for (rcs::HybridBitSet::iterator bi = Solution.begin();
+           bi != Solution.end(); ++bi) {
+        unsigned Target;
+        if (!A.getOffsetMember(*bi, li->Offset, Target))
+          continue;
+        Target = A.WaveRep[Target];
+
+        unsigned Src, Dest;
+        if (li->Type == Constraint::Load) {
+          Src = Target;
+          Dest = A.WaveRep[li->Dest];
+        } else {
+          Src = A.WaveRep[li->Src];
+          Dest = Target;
+        }
+#if !FULL_UNIVERSAL
+        if (Dest < NumberSpecialNodes)
+          continue;
+#endif
+        if (Src != Dest)
+          NewEdges[ThreadID].push_back(WaveEdge(I, Src, Dest));
+      }
+    }
+  }
+};
+
+// Tarjan's algorithm on the copy edges, collapsing every cycle it finds into
+// one node.  Nodes are appended to Finished when their SCC is done, which
+// yields a reverse topological order of the collapsed graph.  Edges to
+// collapsed nodes are rewritten along the way.
+void Andersens::WaveVisit(unsigned NodeIndex, std::vector<unsigned> &Finished) {
+  assert(GraphNodes[NodeIndex].isRep() && "Visiting a non-rep node");
+  unsigned OurDFS = ++DFSNumber;
+  SparseBitVector<> ToErase;
+  SparseBitVector<> NewEdges;
+  Node2DFS[NodeIndex] = OurDFS;
+
+  for (SparseBitVector<>::iterator bi = GraphNodes[NodeIndex].Edges->begin();
+       bi != GraphNodes[NodeIndex].Edges->end();
+       ++bi) {
+    unsigned RepNode = FindNode(*bi);
+    if (RepNode == NodeIndex) {
+      ToErase.set(*bi);
+      continue;
+    }
+    if (RepNode != *bi) {
+      ToErase.set(*bi);
+      NewEdges.set(RepNode);
+    }
+#if !FULL_UNIVERSAL
+    // Nothing propagates into the special nodes, so they never join a cycle.
+    if (RepNode < NumberSpecialNodes)
+      continue;
+#endif
+    if (!Node2Deleted[RepNode]) {
+      if (Node2DFS[RepNode] == 0)
+        WaveVisit(RepNode, Finished);
+      if (Node2DFS[RepNode] < Node2DFS[NodeIndex])
+        Node2DFS[NodeIndex] = Node2DFS[RepNode];
+    }
+  }
+
+  GraphNodes[NodeIndex].Edges->intersectWithComplement(ToErase);
+  GraphNodes[NodeIndex].Edges |= NewEdges;
+
+  if (OurDFS == Node2DFS[NodeIndex]) {
+    while (!SCCStack.empty() && Node2DFS[SCCStack.top()] >= OurDFS) {
+      NodeIndex = UniteNodes(NodeIndex, SCCStack.top());
+      SCCStack.pop();
+    }
+    Node2Deleted[NodeIndex] = true;
+    Finished.push_back(NodeIndex);
+  } else {
+    SCCStack.push(NodeIndex);
+  }
+}
+
+// Group Edges, a list of (Dest, Src) pairs, by Dest.  The sources of Dest end
+// up in Srcs[Begin[Dest], Begin[Dest + 1]).
+static void BuildPredecessorLists(
+    unsigned NumNodes,
+    const std::vector<std::pair<unsigned, unsigned> > &Edges,
+    std::vector<unsigned> &Begin, std::vector<unsigned> &Srcs) {
+  Begin.assign(NumNodes + 1, 0);
+  for (size_t i = 0; i < Edges.size(); ++i)
+    ++Begin[Edges[i].first + 1];
+  for (unsigned i = 0; i < NumNodes; ++i)
+    Begin[i + 1] += Begin[i];
+  Srcs.resize(Edges.size());
+  std::vector<unsigned> Pos(Begin.begin(), Begin.end() - 1);
+  for (size_t i = 0; i < Edges.size(); ++i)
+    Srcs[Pos[Edges[i].first]++] = Edges[i].second;
+}
+
+/// SolveWithWavePropagation - Solve the constraint graph with the technique
+/// described in "Wave Propagation and Deep Propagation for Pointer Analysis"
+/// (Pereira and Berlin, CGO 2009).  Each round has three phases:
+///  1. Collapse the cycles of copy edges, and sort the remaining nodes
+///     topologically.
+///  2. Push the points-to bits each node gained since the last round along
+///     its copy edges, one topological level at a time.  The nodes of a level
+///     only read from lower levels, so each level is processed in parallel.
+///  3. Resolve the load and store constraints of the nodes that gained bits.
+///     This is read-only and runs in parallel.  The copy edges it produces
+///     are added afterwards in the order of the nodes that produced them, so
+///     the result does not depend on how the work was split among threads.
+/// A round that adds no copy edge ends at the fixed point.  HCD's offline
+/// cycles are not used by this solver.  Phase 1 and the bookkeeping between
+/// the phases are serial and linear in the number of nodes, so they bound the
+/// speedup of a round that changes little.
+void Andersens::SolveWithWavePropagation() {
+  unsigned NumNodes = GraphNodes.size();
+  // Each thread interns into its own shard of SetStore.
+  unsigned NumThreads = std::min((unsigned)AndersThreads,
+                                 PointsToSetStore::NumShards);
+  SDTActive = false;
+
+  // Copy edges added by the last round, as (Src, Dest) pairs.
+  std::vector<std::pair<unsigned, unsigned> > FreshEdges;
+  std::vector<std::vector<WaveEdge> > ThreadEdges(NumThreads);
+  std::vector<WaveEdge> NewEdges;
+  std::vector<rcs::HybridBitSet *> Delta(NumNodes, (rcs::HybridBitSet *)NULL);
+
+  for (bool FirstWave = true; ; FirstWave = false) {
+    ++NumIters;
+    DEBUG(errs() << "Starting wave #" << NumIters << "\n");
+    // The work of a wave is the copy edges the last one added.
+    RecordIteration("wave", NumIters, FreshEdges.size());
+
+    // Phase 1: collapse cycles.
+    std::vector<unsigned> Finished;
+    std::fill(Node2DFS.begin(), Node2DFS.end(), 0);
+    std::fill(Node2Deleted.begin(), Node2Deleted.end(), false);
+    DFSNumber = 0;
+    for (unsigned i = 0; i < NumNodes; ++i) {
+      if (GraphNodes[i].isRep() && Node2DFS[i] == 0)
+        WaveVisit(i, Finished);
+    }
+    assert(SCCStack.empty() && "SCC Stack should be empty by now!");
+
+    // The graph does not change shape until phase 3 is over, so flatten the
+    // union-find for the parallel phases.
+    WaveRep.resize(NumNodes);
+    for (unsigned i = 0; i < NumNodes; ++i)
+      WaveRep[i] = FindNode(i);
+
+    // Level each node by its longest path from a source, and collect the
+    // predecessors of each node.
+    std::vector<unsigned> Level(NumNodes, 0);
+    std::vector<std::pair<unsigned, unsigned> > Edges;
+    unsigned NumLevels = 0;
+    for (std::vector<unsigned>::reverse_iterator ni = Finished.rbegin();
+         ni != Finished.rend(); ++ni) {
+      unsigned Src = *ni;
+      NumLevels = std::max(NumLevels, Level[Src] + 1);
+      for (SparseBitVector<>::iterator bi = GraphNodes[Src].Edges->begin();
+           bi != GraphNodes[Src].Edges->end(); ++bi) {
+        unsigned Dest = WaveRep[*bi];
+#if !FULL_UNIVERSAL
+        if (Dest < NumberSpecialNodes)
+          continue;
+#endif
+        if (Dest == Src)
+          continue;
+        Level[Dest] = std::max(Level[Dest], Level[Src] + 1);
+        Edges.push_back(std::make_pair(Dest, Src));
+      }
+    }
+    std::vector<unsigned> PredBegin, Preds;
+    BuildPredecessorLists(NumNodes, Edges, PredBegin, Preds);
+    std::vector<std::pair<unsigned, unsigned> >().swap(Edges);
+
+    for (size_t i = 0; i < FreshEdges.size(); ++i) {
+      unsigned Src = WaveRep[FreshEdges[i].first];
+      unsigned Dest = WaveRep[FreshEdges[i].second];
+      if (Src != Dest)
+        Edges.push_back(std::make_pair(Dest, Src));
+    }
+    std::vector<unsigned> FreshPredBegin, FreshPreds;
+    BuildPredecessorLists(NumNodes, Edges, FreshPredBegin, FreshPreds);
+    std::vector<std::pair<unsigned, unsigned> >().swap(Edges);
+    FreshEdges.clear();
+
+    std::vector<unsigned> LevelBegin(NumLevels + 1, 0);
+    for (size_t i = 0; i < Finished.size(); ++i)
+      ++LevelBegin[Level[Finished[i]] + 1];
+    for (unsigned i = 0; i < NumLevels; ++i)
+      LevelBegin[i + 1] += LevelBegin[i];
+    std::vector<unsigned> LevelNodes(Finished.size());
+    {
+      std::vector<unsigned> Pos(LevelBegin.begin(), LevelBegin.end() - 1);
+      for (std::vector<unsigned>::reverse_iterator ni = Finished.rbegin();
+           ni != Finished.rend(); ++ni)
+        LevelNodes[Pos[Level[*ni]]++] = *ni;
+    }
+
+    // Phase 2: propagate along the copy edges, level by level.
+    for (unsigned L = 0; L < NumLevels; ++L) {
+      WavePullBody Body(*this, &LevelNodes[0] + LevelBegin[L],
+                        PredBegin, Preds, FreshPredBegin, FreshPreds, Delta,
+                        FirstWave);
+      ParallelFor(NumThreads, LevelBegin[L + 1] - LevelBegin[L], Body);
+      SetStore.flushReleases();
+    }
+
+    // Phase 3: resolve the complex constraints.
+    std::vector<unsigned> Complex;
+    for (size_t i = 0; i < LevelNodes.size(); ++i) {
+      unsigned NodeIndex = LevelNodes[i];
+      if (Delta[NodeIndex] && !GraphNodes[NodeIndex].Constraints.empty())
+        Complex.push_back(NodeIndex);
+    }
+    WaveResolveBody Body(*this, Complex, Delta, ThreadEdges);
+    ParallelFor(NumThreads, Complex.size(), Body, 16);
+
+    // All edges of one node come from the same thread, in order, so a stable
+    // sort by node restores the serial order.
+    for (unsigned t = 0; t < NumThreads; ++t) {
+      NewEdges.insert(NewEdges.end(),
+                      ThreadEdges[t].begin(), ThreadEdges[t].end());
+      ThreadEdges[t].clear();
+    }
+    std::stable_sort(NewEdges.begin(), NewEdges.end());
+    for (size_t i = 0; i < NewEdges.size(); ++i) {
+      unsigned Src = NewEdges[i].Src, Dest = NewEdges[i].Dest;
+      if (GraphNodes[Src].Edges->test_and_set(Dest))
+        FreshEdges.push_back(std::make_pair(Src, Dest));
+    }
+    NewEdges.clear();
+
+    // Only the nodes of this round can have a delta.
+    for (size_t i = 0; i < LevelNodes.size(); ++i) {
+      delete Delta[LevelNodes[i]];
+      Delta[LevelNodes[i]] = NULL;
+    }
+
+    if (FreshEdges.empty())
+      break;
+  }
+
+  WaveRep.clear();
+}
+
+//===----------------------------------------------------------------------===//
+//                            Incremental Solving
+//===----------------------------------------------------------------------===//
+
+// Name a global or a function in a way that survives edits to the rest of the
+// module.
+static std::string getGlobalKey(const GlobalValue *GV, unsigned Index) {
+  if (GV->hasName())
+    return "@" + GV->getName().str();
+  return (isa<Function>(GV) ? "@f#" : "@g#") + utostr(Index);
+}
+
+/// BeginConstraintGroup - Attribute the constraints collected from now on to
+/// function F, or to the module if F is null.
+void Andersens::BeginConstraintGroup(Function *F, unsigned Index) {
+  if (IncrementalState.empty())
+    return;
+  EndConstraintGroup();
+  ConstraintGroup G;
+  G.Name = (F ? getGlobalKey(F, Index) : "<module>");
+  G.F = F;
+  G.Begin = G.End = Constraints.size();
+  G.FirstNode = G.EndNode = GraphNodes.size();
+  ConstraintGroups.push_back(G);
+}
+
+void Andersens::EndConstraintGroup() {
+  if (ConstraintGroups.empty())
+    return;
+  ConstraintGroups.back().End = Constraints.size();
+  ConstraintGroups.back().EndNode = GraphNodes.size();
+}
+
+/// ComputeNodeKeys - Give every node a name that identifies it across runs:
+/// the global or function it belongs to, and its role or the position of its
+/// instruction in the function.
+void Andersens::ComputeNodeKeys(Module &M) {
+  NodeKeys.assign(GraphNodes.size(), std::string());
+  NodeKeys[UniversalSet] = "<universal>";
+  NodeKeys[NullPtr] = "<null>";
+  NodeKeys[NullObject] = "<null-object>";
+  NodeKeys[IntNode] = "<int>";
+  NodeKeys[AggregateNode] = "<aggregate>";
+  NodeKeys[PthreadSpecificNode] = "<pthread-specific>";
+
+  unsigned Index = 0;
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I) {
+    std::string Key = getGlobalKey(I, Index++);
+    NodeKeys[getObject(I)] = Key + ".obj";
+    NodeKeys[getNode(I)] = Key;
+  }
+
+  Index = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    std::string Key = getGlobalKey(F, Index++);
+    NodeKeys[getObject(F)] = Key + ".obj";
+    NodeKeys[getNode(F)] = Key;
+    if (ReturnNodes.count(F))
+      NodeKeys[getReturnNode(F)] = Key + ".ret";
+    if (VarargNodes.count(F))
+      NodeKeys[getVarargNode(F)] = Key + ".va";
+
+    unsigned ArgNo = 0;
+    for (Function::arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+         AI != AE; ++AI, ++ArgNo) {
+      if (isa<PointerType>(AI->getType()))
+        NodeKeys[getNode(AI)] = Key + ".arg" + utostr(ArgNo);
+    }
+
+    unsigned InstNo = 0;
+    for (inst_iterator II = inst_begin(F), IE = inst_end(F); II != IE;
+         ++II, ++InstNo) {
+      std::string InstKey = Key + "#" + utostr(InstNo);
+      DenseMap<Value*, unsigned>::iterator I = ValueNodes.find(&*II);
+      if (I != ValueNodes.end())
+        NodeKeys[I->second] = InstKey;
+      I = ObjectNodes.find(&*II);
+      if (I != ObjectNodes.end())
+        NodeKeys[I->second] = InstKey + ".obj";
+      if (CallInst *CI = dyn_cast<CallInst>(&*II)) {
+        Value *Callee = CI->getCalledValue();
+        if (isa<InlineAsm>(Callee))
+          NodeKeys[getNode(Callee)] = InstKey + ".asm";
+      }
+    }
+  }
+
+  // Temporaries created while collecting the constraints of a function.
+  for (size_t i = 0; i < ConstraintGroups.size(); ++i) {
+    const ConstraintGroup &G = ConstraintGroups[i];
+    for (unsigned n = G.FirstNode; n < G.EndNode; ++n)
+      NodeKeys[n] = G.Name + "~" + utostr(n - G.FirstNode);
+  }
+}
+
+/// WriteIncrementalState - Save the node keys, the solution and the collected
+/// constraints for the next incremental run.  Everything is written in the
+/// current node numbering.
+void Andersens::WriteIncrementalState() {
+  std::string ErrorInfo;
+  raw_fd_ostream Out(IncrementalState.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << ErrorInfo << "\n";
+    return;
+  }
+
+  unsigned Size = GraphNodes.size();
+  Out << "anders-incremental-state 1\n" << Size << "\n";
+  for (unsigned i = 0; i < Size; ++i)
+    Out << NodeKeys[i] << "\n";
+
+  std::vector<unsigned> Solved;
+  for (unsigned i = 0; i < Size; ++i) {
+    const Node *N = &GraphNodes[FindNode(i)];
+    if (!NodeKeys[i].empty() && N->PointsTo && !N->PointsTo->empty())
+      Solved.push_back(i);
+  }
+  Out << Solved.size() << "\n";
+  for (size_t i = 0; i < Solved.size(); ++i) {
+    const rcs::HybridBitSet *PointsTo =
+        GraphNodes[FindNode(Solved[i])].PointsTo;
+    Out << Solved[i] << " " << PointsTo->count();
+    for (rcs::HybridBitSet::iterator bi = PointsTo->begin();
+         bi != PointsTo->end(); ++bi)
+      Out << " " << *bi;
+    Out << "\n";
+  }
+
+  Out << ConstraintGroups.size() << "\n";
+  for (size_t i = 0; i < ConstraintGroups.size(); ++i) {
+    const ConstraintGroup &G = ConstraintGroups[i];
+    Out << G.Name << "\n" << G.End - G.Begin << "\n";
+    for (unsigned j = G.Begin; j < G.End; ++j) {
+      const Constraint &C = CollectedConstraints[j];
+      unsigned Dest = (Renumbering.empty() ? C.Dest : Renumbering[C.Dest]);
+      unsigned Src = (Renumbering.empty() ? C.Src : Renumbering[C.Src]);
+      Out << C.Type << " " << Dest << " " << Src << " " << C.Offset << "\n";
+    }
+  }
+}
+
+/// ReadIncrementalState - Load what WriteIncrementalState saved.  OldToNew
+/// maps the saved node numbers to the current ones, or to ~0U for the nodes
+/// that are gone.  The saved points-to sets and constraint groups are left in
+/// the saved numbering.
+bool Andersens::ReadIncrementalState(
+    std::vector<unsigned> &OldToNew,
+    std::vector<std::vector<unsigned> > &SavedPointsTo,
+    std::map<std::string, std::vector<Constraint> > &SavedGroups) {
+  std::ifstream In(IncrementalState.c_str());
+  std::string Magic;
+  unsigned Version = 0;
+  In >> Magic >> Version;
+  if (!In || Magic != "anders-incremental-state" || Version != 1)
+    return false;
+
+  StringMap<unsigned> KeyToNode;
+  for (unsigned i = 0; i < NodeKeys.size(); ++i) {
+    if (!NodeKeys[i].empty())
+      KeyToNode[NodeKeys[i]] = i;
+  }
+
+  unsigned NumSavedNodes = 0;
+  In >> NumSavedNodes;
+  In.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  OldToNew.assign(NumSavedNodes, ~0U);
+  std::string Key;
+  for (unsigned i = 0; i < NumSavedNodes && std::getline(In, Key); ++i) {
+    StringMap<unsigned>::iterator I = KeyToNode.find(Key);
+    if (!Key.empty() && I != KeyToNode.end())
+      OldToNew[i] = I->second;
+  }
+
+  unsigned NumSets = 0;
+  In >> NumSets;
+  SavedPointsTo.assign(NumSavedNodes, std::vector<unsigned>());
+  for (unsigned i = 0; i < NumSets && In; ++i) {
+    unsigned NodeIndex = 0, SetSize = 0;
+    In >> NodeIndex >> SetSize;
+    if (!In || NodeIndex >= NumSavedNodes)
+      return false;
+    std::vector<unsigned> &Set = SavedPointsTo[NodeIndex];
+    Set.resize(SetSize);
+    for (unsigned j = 0; j < SetSize; ++j) {
+      In >> Set[j];
+      if (Set[j] >= NumSavedNodes)
+        return false;
+    }
+  }
+
+  unsigned NumGroups = 0;
+  In >> NumGroups;
+  In.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  for (unsigned i = 0; i < NumGroups && In; ++i) {
+    std::string Name;
+    unsigned GroupSize = 0;
+    std::getline(In, Name);
+    In >> GroupSize;
+    std::vector<Constraint> &Group = SavedGroups[Name];
+    for (unsigned j = 0; j < GroupSize; ++j) {
+      unsigned Type = 0, Dest = 0, Src = 0, Offset = 0;
+      In >> Type >> Dest >> Src >> Offset;
+      if (!In || Type > Constraint::AddressOf || Dest >= NumSavedNodes ||
+          Src >= NumSavedNodes || (Type == Constraint::AddressOf && Offset))
+        return false;
+      Group.push_back(Constraint((Constraint::ConstraintType)Type,
+                                 Dest, Src, Offset));
+    }
+    In.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return !In.fail();
+}
+
+/// AddRemovalSeeds - Collect the nodes whose points-to sets a removed
+/// constraint, in the saved numbering, may have contributed to.
+void Andersens::AddRemovalSeeds(
+    const Constraint &C, const std::vector<unsigned> &OldToNew,
+    const std::vector<std::vector<unsigned> > &SavedPointsTo,
+    std::vector<unsigned> &Seeds) const {
+  if (C.Type != Constraint::Store) {
+    if (OldToNew[C.Dest] != ~0U)
+      Seeds.push_back(OldToNew[C.Dest]);
+    return;
+  }
+  // A store wrote into everything its pointer pointed to.
+  const std::vector<unsigned> &Pointees = SavedPointsTo[C.Dest];
+  for (size_t i = 0; i < Pointees.size(); ++i) {
+    unsigned Target;
+    if (OldToNew[Pointees[i]] != ~0U &&
+        getOffsetMember(OldToNew[Pointees[i]], C.Offset, Target))
+      Seeds.push_back(Target);
+  }
+}
+
+/// SolveIncrementally - Solve the constraints starting from the solution
+/// saved by the last run with -anders-incremental-state.  The constraints of
+/// each function are compared with the saved ones through the node keys.
+///  - Every node that a removed constraint may have contributed to, i.e.
+///    everything reachable from its target in the saved solution, is reset
+///    and solved again.
+///  - All other nodes start from their saved points-to sets.  Adding
+///    constraints only grows the solution, so these are a sound start.
+/// The solver runs on the unoptimized constraints, because the offline
+/// optimizations are about as expensive as the solve we try to avoid.
+/// Returns false, without touching the graph, if there is no usable state or
+/// too many nodes would have to be reset.
+bool Andersens::SolveIncrementally() {
+  PhaseScope Phase(*this, "SolveIncrementally");
+  std::vector<unsigned> OldToNew;
+  std::vector<std::vector<unsigned> > SavedPointsTo;
+  std::map<std::string, std::vector<Constraint> > SavedGroups;
+  if (!ReadIncrementalState(OldToNew, SavedPointsTo, SavedGroups)) {
+    errs() << "No usable incremental state in " << IncrementalState << "\n";
+    return false;
+  }
+
+  unsigned Size = GraphNodes.size();
+  std::vector<rcs::HybridBitSet > Saved(Size);
+  for (unsigned i = 0; i < SavedPointsTo.size(); ++i) {
+    if (OldToNew[i] == ~0U)
+      continue;
+    rcs::HybridBitSet &Set = Saved[OldToNew[i]];
+    for (size_t j = 0; j < SavedPointsTo[i].size(); ++j) {
+      if (OldToNew[SavedPointsTo[i][j]] != ~0U)
+        Set.set(OldToNew[SavedPointsTo[i][j]]);
+    }
+  }
+
+  // Compare the constraint groups.
+  std::vector<unsigned> Seeds;
+  unsigned NumChangedGroups = 0;
+  for (size_t i = 0; i < ConstraintGroups.size(); ++i) {
+    const ConstraintGroup &G = ConstraintGroups[i];
+    std::set<Constraint> Current(Constraints.begin() + G.Begin,
+                                 Constraints.begin() + G.End);
+    std::set<Constraint> Kept;
+    bool Changed = false;
+    std::map<std::string, std::vector<Constraint> >::iterator SI =
+        SavedGroups.find(G.Name);
+    if (SI != SavedGroups.end()) {
+      for (size_t j = 0; j < SI->second.size(); ++j) {
+        const Constraint &C = SI->second[j];
+        if (OldToNew[C.Dest] != ~0U && OldToNew[C.Src] != ~0U) {
+          Constraint Renamed(C.Type, OldToNew[C.Dest], OldToNew[C.Src],
+                             C.Offset);
+          if (Current.count(Renamed)) {
+            Kept.insert(Renamed);
+            continue;
+          }
+        }
+        Changed = true;
+        AddRemovalSeeds(C, OldToNew, SavedPointsTo, Seeds);
+      }
+      SavedGroups.erase(SI);
+    }
+    if (Kept.size() != Current.size())
+      Changed = true;
+    if (!Changed)
+      continue;
+
+    ++NumChangedGroups;
+    // Offsets into a function object depend on its signature, so the nodes
+    // of a changed function may lose what indirect calls put there.
+    if (G.F) {
+      unsigned First = getNode(G.F);
+      std::map<unsigned, unsigned>::const_iterator K = MaxK.find(First);
+      for (unsigned k = 0; K != MaxK.end() && k < K->second; ++k)
+        Seeds.push_back(First + k);
+    }
+  }
+  // Groups of the functions that are gone.
+  for (std::map<std::string, std::vector<Constraint> >::iterator
+       SI = SavedGroups.begin(), SE = SavedGroups.end(); SI != SE; ++SI) {
+    ++NumChangedGroups;
+    for (size_t j = 0; j < SI->second.size(); ++j)
+      AddRemovalSeeds(SI->second[j], OldToNew, SavedPointsTo, Seeds);
+  }
+  std::vector<std::vector<unsigned> >().swap(SavedPointsTo);
+  std::map<std::string, std::vector<Constraint> >().swap(SavedGroups);
+
+  // Everything the seeds reach through the copy edges, including the ones
+  // the complex constraints add under the saved solution.
+  std::vector<bool> Reset(Size, false);
+  unsigned NumReset = 0;
+  if (!Seeds.empty()) {
+    std::vector<std::vector<unsigned> > Succs(Size);
+    for (unsigned i = 0; i < Constraints.size(); ++i) {
+      const Constraint &C = Constraints[i];
+      unsigned Target;
+      if (C.Type == Constraint::Copy) {
+        if (C.Offset == 0)
+          Succs[C.Src].push_back(C.Dest);
+      } else if (C.Type == Constraint::Load) {
+        Succs[C.Src].push_back(C.Dest);
+        for (rcs::HybridBitSet::iterator bi = Saved[C.Src].begin();
+             bi != Saved[C.Src].end(); ++bi) {
+          if (getOffsetMember(*bi, C.Offset, Target))
+            Succs[Target].push_back(C.Dest);
+        }
+      } else if (C.Type == Constraint::Store) {
+        for (rcs::HybridBitSet::iterator bi = Saved[C.Dest].begin();
+             bi != Saved[C.Dest].end(); ++bi) {
+          if (getOffsetMember(*bi, C.Offset, Target)) {
+            Succs[C.Dest].push_back(Target);
+            Succs[C.Src].push_back(Target);
+          }
+        }
+      }
+    }
+
+    while (!Seeds.empty()) {
+      unsigned NodeIndex = Seeds.back();
+      Seeds.pop_back();
+      if (Reset[NodeIndex])
+        continue;
+      Reset[NodeIndex] = true;
+      ++NumReset;
+      for (size_t j = 0; j < Succs[NodeIndex].size(); ++j) {
+        if (!Reset[Succs[NodeIndex][j]])
+          Seeds.push_back(Succs[NodeIndex][j]);
+      }
+    }
+  }
+
+  errs() << "Incremental solve: " << NumChangedGroups
+         << " changed constraint groups, " << NumReset << " of " << Size
+         << " nodes reset\n";
+  if ((uint64_t)NumReset * 100 > (uint64_t)Size * IncrementalResetLimit) {
+    errs() << "Too many nodes to reset; solving from scratch\n";
+    return false;
+  }
+  NumIncrementalReset += NumReset;
+
+  SDT.assign(Size, -1);
+  SDTActive = false;
+  CreateSolverGraph();
+  for (unsigned i = 0; i < Size; ++i) {
+    if (Reset[i] || Saved[i].empty())
+      continue;
+    Node *N = &GraphNodes[i];
+    *N->PointsTo |= Saved[i];
+    SetOldPointsTo(N, Saved[i]);
+  }
+  std::vector<rcs::HybridBitSet >().swap(Saved);
+
+  // Add the copy edges the complex constraints imply under the start
+  // solution, and push every points-to set along every edge once.  After
+  // that, each node's OldPointsTo has reached everywhere it should, which is
+  // what the solver expects.
+  for (unsigned i = 0; i < Size; ++i) {
+    Node *N = &GraphNodes[i];
+    for (std::list<Constraint>::iterator li = N->Constraints.begin();
+         li != N->Constraints.end(); ++li) {
+      if (li->Type != Constraint::Load && li->Type != Constraint::Store)
+        continue;
+      for (rcs::HybridBitSet::iterator bi = N->PointsTo->begin();
+           bi != N->PointsTo->end(); ++bi) {
+        unsigned Target;
+        if (!getOffsetMember(*bi, li->Offset, Target))
+          continue;
+        unsigned Src = (li->Type == Constraint::Load ? Target : li->Src);
+        unsigned Dest = (li->Type == Constraint::Load ? li->Dest : Target);
+#if !FULL_UNIVERSAL
+        if (Dest < NumberSpecialNodes)
+          continue;
+#endif
+        GraphNodes[Src].Edges->set(Dest);
+      }
+    }
+  }
+  for (unsigned i = 0; i < Size; ++i) {
+    Node *N = &GraphNodes[i];
+    for (SparseBitVector<>::iterator bi = N->Edges->begin();
+         bi != N->Edges->end(); ++bi) {
+#if !FULL_UNIVERSAL
+      if (*bi < NumberSpecialNodes)
+        continue;
+#endif
+      if (*bi != i)
+        *GraphNodes[*bi].PointsTo |= *N->PointsTo;
+    }
+  }
+
+  PropagateConstraints(AndersWorkList, AndersThreads);
+  FinishSolving();
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                         Demand-Driven Queries
+//===----------------------------------------------------------------------===//
+
+/// DemandQuery - The nodes pulled into one demand-driven query, with their
+/// points-to sets so far.  Nodes solved by earlier queries come with their
+/// final sets and are never recomputed.
+struct Andersens::DemandQuery {
+  Andersens &A;
+  std::vector<unsigned> Nodes;
+  // NULL for nodes that were already solved.
+  std::vector<rcs::HybridBitSet *> Sets;
+  DenseMap<unsigned, unsigned> Slots;
+
+  explicit DemandQuery(Andersens &AA): A(AA) {}
+
+  ~DemandQuery() {
+    for (unsigned i = 0; i < Sets.size(); ++i)
+      delete Sets[i];
+  }
+
+  /// demand - Pull N into the query, and return its current points-to set.
+  const rcs::HybridBitSet &demand(unsigned N) {
+    std::pair<DenseMap<unsigned, unsigned>::iterator, bool> I =
+        Slots.insert(std::make_pair(N, (unsigned)Nodes.size()));
+    unsigned Slot = I.first->second;
+    if (I.second) {
+      Nodes.push_back(N);
+      Sets.push_back(A.GraphNodes[N].PointsTo ? NULL : new rcs::HybridBitSet);
+    }
+    return get(Slot);
+  }
+
+  const rcs::HybridBitSet &get(unsigned Slot) const {
+    return Sets[Slot] ? *Sets[Slot] : *A.GraphNodes[Nodes[Slot]].PointsTo;
+  }
+};
+
+/// BuildDemandIndex - Index the constraints by the node whose points-to set
+/// they feed, for SolveOnDemand to walk backwards.
+void Andersens::BuildDemandIndex() {
+  PhaseScope Phase(*this, "BuildDemandIndex");
+  DemandInEdges.assign(GraphNodes.size(), std::vector<unsigned>());
+  DemandStores.clear();
+  DemandStoreUsers.assign(GraphNodes.size(), std::vector<unsigned>());
+  DemandOverBudget.clear();
+  std::set<unsigned> Offsets;
+  Offsets.insert(0);
+  for (unsigned i = 0, e = Constraints.size(); i != e; ++i) {
+    const Constraint &C = Constraints[i];
+    if (C.Type == Constraint::Store) {
+      DemandStoreUsers[C.Dest].push_back(DemandStores.size());
+      if (C.Src != C.Dest)
+        DemandStoreUsers[C.Src].push_back(DemandStores.size());
+      DemandStores.push_back(i);
+      Offsets.insert(C.Offset);
+    } else if (C.Type == Constraint::Load) {
+      DemandInEdges[C.Dest].push_back(i);
+      Offsets.insert(C.Offset);
+    } else if (C.Type == Constraint::AddressOf || C.Offset == 0) {
+      // Like the solver, we ignore copies with an offset.
+      DemandInEdges[C.Dest].push_back(i);
+    }
+  }
+
+  // Stores can only write to objects, at the offsets they use.
+  DemandStoreTargets.clear();
+  for (unsigned i = 0, e = Constraints.size(); i != e; ++i) {
+    const Constraint &C = Constraints[i];
+    if (C.Type != Constraint::AddressOf)
+      continue;
+    for (std::set<unsigned>::iterator I = Offsets.begin(), E = Offsets.end();
+         I != E; ++I) {
+      unsigned Target;
+      if (getOffsetMember(C.Src, *I, Target))
+        DemandStoreTargets.set(Target);
+    }
+  }
+  Demand = true;
+}
+
+/// SolveOnDemand - Compute the points-to set of Root from the constraints it
+/// depends on, without solving the rest.  The query pulls in the sources of
+/// the constraints into each node it needs, and the pointers of all stores
+/// once it needs an object that a store may write, and iterates to a fixed
+/// point.  All nodes it pulled in are then solved, and keep their sets for
+/// later queries.  Returns false if the query gives up after -anders-demand-
+/// budget constraint evaluations, and remembers that for later queries of
+/// Root.
+///
+/// Each store is evaluated once when stores are first needed, and again only
+/// when the set of its pointer or its source changes.  Evaluating a store
+/// indexes it by the objects it may write, so that an object joining the
+/// query later gets the stored values without a scan of all stores.
+bool Andersens::SolveOnDemand(unsigned Root) {
+  if (GraphNodes[Root].PointsTo) {
+    ++NumDemandCacheHits;
+    return true;
+  }
+  if (DemandOverBudget.test(Root)) {
+    ++NumDemandKnownGiveUps;
+    return false;
+  }
+  ++NumDemandQueries;
+
+  DemandQuery Q(*this);
+  Q.demand(Root);
+  std::vector<unsigned> Members;
+  bool NeedStores = false;
+  // Stores to evaluate in the next round, as indices into DemandStores.
+  std::vector<unsigned> DirtyStores;
+  DenseSet<unsigned> IsDirty;
+  // Object -> the stores whose pointer may point to it.
+  DenseMap<unsigned, std::vector<unsigned> > StoresByTarget;
+  DenseSet<std::pair<unsigned, unsigned> > Indexed;
+  unsigned Steps = 0;
+  unsigned NumIndexed = 0;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    unsigned NumNodes = Q.Nodes.size();
+
+    for (unsigned Slot = 0; Slot < Q.Nodes.size(); ++Slot) {
+      if (!Q.Sets[Slot])
+        continue;
+      unsigned N = Q.Nodes[Slot];
+      if (!NeedStores && DemandStoreTargets.test(N)) {
+        NeedStores = true;
+        for (unsigned i = 0; i < DemandStores.size(); ++i) {
+          if (IsDirty.insert(i).second)
+            DirtyStores.push_back(i);
+        }
+      }
+
+      bool SetChanged = false;
+      const std::vector<unsigned> &In = DemandInEdges[N];
+      for (unsigned i = 0; i < In.size(); ++i) {
+        if (DemandBudget && ++Steps > DemandBudget) {
+          ++NumDemandGiveUps;
+          DemandOverBudget.set(Root);
+          return false;
+        }
+        const Constraint &C = Constraints[In[i]];
+        rcs::HybridBitSet &Pts = *Q.Sets[Slot];
+        if (C.Type == Constraint::AddressOf) {
+          SetChanged |= Pts.test_and_set(C.Src);
+          continue;
+        }
+#if !FULL_UNIVERSAL
+        // Nothing is propagated into the special nodes.
+        if (N < NumberSpecialNodes)
+          continue;
+#endif
+        if (C.Type == Constraint::Copy) {
+          const rcs::HybridBitSet &Src = Q.demand(C.Src);
+          if (&Src != &Pts)
+            SetChanged |= (Pts |= Src);
+          continue;
+        }
+
+        // A load: N gets the sets of the objects at C.Offset in the
+        // points-to set of C.Src.
+        Members.clear();
+        const rcs::HybridBitSet &Pointer = Q.demand(C.Src);
+        for (rcs::HybridBitSet::iterator bi = Pointer.begin();
+             bi != Pointer.end(); ++bi) {
+          unsigned Target;
+          if (getOffsetMember(*bi, C.Offset, Target))
+            Members.push_back(Target);
+        }
+        for (unsigned j = 0; j < Members.size(); ++j) {
+          const rcs::HybridBitSet &Src = Q.demand(Members[j]);
+          if (&Src != &Pts)
+            SetChanged |= (Pts |= Src);
+        }
+      }
+      if (SetChanged) {
+        Changed = true;
+        if (NeedStores) {
+          const std::vector<unsigned> &Users = DemandStoreUsers[N];
+          for (unsigned i = 0; i < Users.size(); ++i) {
+            if (IsDirty.insert(Users[i]).second)
+              DirtyStores.push_back(Users[i]);
+          }
+        }
+      }
+    }
+
+    if (NeedStores) {
+      // Objects that joined the query since the last round get the values of
+      // the stores known to write them.
+      for (unsigned Slot = NumIndexed; Slot < Q.Nodes.size(); ++Slot) {
+        DenseMap<unsigned, std::vector<unsigned> >::iterator I =
+            StoresByTarget.find(Q.Nodes[Slot]);
+        if (I == StoresByTarget.end() || !Q.Sets[Slot])
+          continue;
+        for (unsigned i = 0; i < I->second.size(); ++i) {
+          if (IsDirty.insert(I->second[i]).second)
+            DirtyStores.push_back(I->second[i]);
+        }
+      }
+      NumIndexed = Q.Nodes.size();
+
+      std::vector<unsigned> Stores;
+      Stores.swap(DirtyStores);
+      IsDirty.clear();
+      for (unsigned i = 0; i < Stores.size(); ++i) {
+        if (DemandBudget && ++Steps > DemandBudget) {
+          ++NumDemandGiveUps;
+          DemandOverBudget.set(Root);
+          return false;
+        }
+        const Constraint &C = Constraints[DemandStores[Stores[i]]];
+        Members.clear();
+        const rcs::HybridBitSet &Pointer = Q.demand(C.Dest);
+        for (rcs::HybridBitSet::iterator bi = Pointer.begin();
+             bi != Pointer.end(); ++bi) {
+          unsigned Target;
+          if (!getOffsetMember(*bi, C.Offset, Target))
+            continue;
+#if !FULL_UNIVERSAL
+          if (Target < NumberSpecialNodes)
+            continue;
+#endif
+          if (Indexed.insert(std::make_pair(Target, Stores[i])).second)
+            StoresByTarget[Target].push_back(Stores[i]);
+          // Only objects in the query need the stored values.
+          DenseMap<unsigned, unsigned>::iterator I = Q.Slots.find(Target);
+          if (I != Q.Slots.end() && Q.Sets[I->second])
+            Members.push_back(I->second);
+        }
+        if (Members.empty())
+          continue;
+        const rcs::HybridBitSet &Src = Q.demand(C.Src);
+        for (unsigned j = 0; j < Members.size(); ++j) {
+          rcs::HybridBitSet &Pts = *Q.Sets[Members[j]];
+          if (&Src == &Pts || !(Pts |= Src))
+            continue;
+          Changed = true;
+          const std::vector<unsigned> &Users =
+              DemandStoreUsers[Q.Nodes[Members[j]]];
+          for (unsigned k = 0; k < Users.size(); ++k) {
+            if (IsDirty.insert(Users[k]).second)
+              DirtyStores.push_back(Users[k]);
+          }
+        }
+      }
+      if (!DirtyStores.empty())
+        Changed = true;
+    }
+
+    if (Q.Nodes.size() != NumNodes)
+      Changed = true;
+  }
+
+  // Every constraint into the nodes of the query has been applied, so their
+  // sets are final.
+  for (unsigned Slot = 0; Slot < Q.Nodes.size(); ++Slot) {
+    if (!Q.Sets[Slot])
+      continue;
+    Node *N = &GraphNodes[Q.Nodes[Slot]];
+    N->PointsToSet = SetStore.intern(*Q.Sets[Slot]);
+    N->PointsTo = SetStore.getBitmap(N->PointsToSet);
+  }
+  NumPointsToSets = SetStore.getNumSets();
+  return true;
+}
+
+/// isSolved - Make sure N has its points-to set.  Returns false if it has
+/// none because a demand-driven query gave up.
+bool Andersens::isSolved(Node *N) {
+  return !Demand || SolveOnDemand(N - &GraphNodes[0]);
+}
+
+//===----------------------------------------------------------------------===//
+//                     Frozen Solution and Snapshots
+//===----------------------------------------------------------------------===//
+
+// Layout of a snapshot file: the header, followed by the arrays of
+// SolvedGraph in the order they are declared, all as native 32-bit integers.
+namespace {
+struct SnapshotHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t NumValues;
+  uint32_t NumNodes;
+  uint32_t NumSets;
+  uint32_t NumElements;
+  uint32_t Padding;
+  // Fingerprint of the module from HashModule.
+  uint64_t ModuleHash;
+};
+}
+static const char SnapshotMagic[8] = "ANDSNAP";
+static const uint32_t SnapshotVersion = 4;
+
+bool Andersens::SolvedGraph::intersectsIgnoring(unsigned N1, unsigned N2,
+                                                unsigned Ignoring) const {
+  const uint32_t *I1 = begin(N1), *E1 = end(N1);
+  const uint32_t *I2 = begin(N2), *E2 = end(N2);
+  while (I1 != E1 && I2 != E2) {
+    if (*I1 < *I2) {
+      ++I1;
+    } else if (*I2 < *I1) {
+      ++I2;
+    } else {
+      if (*I1 != Ignoring)
+        return true;
+      ++I1;
+      ++I2;
+    }
+  }
+  return false;
+}
+
+bool Andersens::SolvedGraph::contains(unsigned N, unsigned Element) const {
+  return std::binary_search(begin(N), end(N), Element);
+}
+
+/// isValid - Return true if every index in the arrays is in range, and every
+/// set is sorted, so that queries never read outside the arrays.
+bool Andersens::SolvedGraph::isValid() const {
+  for (unsigned i = 0; i < NumValues; ++i) {
+    if (ValueNodes[i] != ~0U && ValueNodes[i] >= NumNodes)
+      return false;
+  }
+  for (unsigned i = 0; i < NumNodes; ++i) {
+    if ((NodeValues[i] != ~0U && NodeValues[i] >= NumValues) ||
+        Reps[i] >= NumNodes || NodeSets[i] >= NumSets)
+      return false;
+  }
+  if (SetBegin[0] != 0 || SetBegin[NumSets] != NumElements)
+    return false;
+  for (unsigned S = 0; S < NumSets; ++S) {
+    if (SetBegin[S] > SetBegin[S + 1])
+      return false;
+    for (unsigned i = SetBegin[S]; i < SetBegin[S + 1]; ++i) {
+      if (Elements[i] >= NumNodes ||
+          (i > SetBegin[S] && Elements[i] <= Elements[i - 1]))
+        return false;
+    }
+  }
+  return true;
+}
+
+/// getNodeIfAny - Like getNode, but returns false instead of aborting on
+/// values without a node.
+bool Andersens::getNodeIfAny(Value *V, unsigned &NodeIndex) const {
+  if (!isa<PointerType>(V->getType()))
+    return false;
+  if (Constant *C = dyn_cast<Constant>(V)) {
+    if (isa<ConstantPointerNull>(C) || isa<UndefValue>(C)) {
+      NodeIndex = NullPtr;
+      return true;
+    }
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+      switch (CE->getOpcode()) {
+        case Instruction::GetElementPtr:
+        case Instruction::BitCast:
+          return getNodeIfAny(CE->getOperand(0), NodeIndex);
+        case Instruction::IntToPtr:
+          NodeIndex = UniversalSet;
+          return true;
+        default:
+          return false;
+      }
+    }
+    if (!isa<GlobalValue>(C))
+      return false;
+  }
+  DenseMap<Value*, unsigned>::const_iterator I = ValueNodes.find(V);
+  if (I == ValueNodes.end())
+    return false;
+  NodeIndex = I->second;
+  return true;
+}
+
+/// getSolvedNode - Return the node of V in Solved, or ~0U if it has none.
+unsigned Andersens::getSolvedNode(const Value *V) const {
+  if (!SnapshotBuffer) {
+    unsigned NodeIndex;
+    if (!getNodeIfAny(const_cast<Value *>(V), NodeIndex))
+      return ~0U;
+    return Solved.Reps[NodeIndex];
+  }
+  unsigned ValueID = IDA->getValueID(V);
+  if (ValueID == rcs::IDAssigner::InvalidID || ValueID >= Solved.NumValues)
+    return ~0U;
+  return Solved.ValueNodes[ValueID];
+}
+
+/// getSolvedValue - Return the value of node N of Solved, or NULL if it has
+/// none.
+Value *Andersens::getSolvedValue(unsigned N) const {
+  if (!SnapshotBuffer)
+    return SolvedValues[N];
+  if (Solved.NodeValues[N] == ~0U)
+    return NULL;
+  return IDA->getValue(Solved.NodeValues[N]);
+}
+
+void Andersens::SolvedGraph::map(const uint32_t *P) {
+  ValueNodes = P;
+  P += NumValues;
+  NodeValues = P;
+  P += NumNodes;
+  NodeFlags = P;
+  P += NumNodes;
+  Reps = P;
+  P += NumNodes;
+  NodeSets = P;
+  P += NumNodes;
+  SetBegin = P;
+  P += NumSets + 1;
+  Elements = P;
+}
+
+/// FlattenSolution - Lay out the solved graph as the arrays of Solved, in
+/// SolvedArrays.  Values are identified by their IDAssigner IDs if IDA is
+/// available, so that the arrays can be saved as a snapshot.
+void Andersens::FlattenSolution() {
+  PhaseScope Phase(*this, "FlattenSolution");
+  unsigned NumValues = (IDA ? IDA->getNumValues() : 0);
+  unsigned Size = GraphNodes.size();
+
+  std::vector<uint32_t> ValueNodeArray(NumValues, ~0U);
+  for (unsigned i = 0; i < NumValues; ++i) {
+    Value *V = IDA->getValue(i);
+    unsigned NodeIndex;
+    if (V && getNodeIfAny(V, NodeIndex))
+      ValueNodeArray[i] = FindNode(NodeIndex);
+  }
+
+  std::vector<uint32_t> NodeValues(Size), NodeFlags(Size), Reps(Size);
+  std::vector<uint32_t> NodeSets(Size), SetBegin(1, 0), Elements;
+  SolvedValues.resize(Size);
+  DenseMap<unsigned, unsigned> SetIndex;
+  for (unsigned i = 0; i < Size; ++i) {
+    Value *V = GraphNodes[i].getValue();
+    SolvedValues[i] = V;
+    NodeValues[i] = (V && IDA ? IDA->getValueID(V) : ~0U);
+    NodeFlags[i] = 0;
+    if (V ? isa<GlobalValue>(V) && !(isa<GlobalVariable>(V) &&
+                                     !cast<GlobalVariable>(V)->isConstant())
+          : i == NullObject)
+      NodeFlags[i] |= SolvedGraph::ConstantMemory;
+    if (V && isObjectNode(V, i))
+      NodeFlags[i] |= SolvedGraph::Object;
+
+    Reps[i] = FindNode(i);
+    const Node *R = &GraphNodes[Reps[i]];
+    std::pair<DenseMap<unsigned, unsigned>::iterator, bool> Inserted =
+        SetIndex.insert(std::make_pair(R->PointsToSet, SetBegin.size() - 1));
+    if (Inserted.second && R->PointsTo) {
+      for (rcs::HybridBitSet::iterator bi = R->PointsTo->begin();
+           bi != R->PointsTo->end(); ++bi)
+        Elements.push_back(*bi);
+    }
+    if (Inserted.second)
+      SetBegin.push_back(Elements.size());
+    NodeSets[i] = Inserted.first->second;
+  }
+
+  Solved.NumValues = NumValues;
+  Solved.NumNodes = Size;
+  Solved.NumSets = SetBegin.size() - 1;
+  Solved.NumElements = Elements.size();
+  std::vector<uint32_t> Arrays;
+  Arrays.reserve(Solved.getNumWords());
+  Arrays.insert(Arrays.end(), ValueNodeArray.begin(), ValueNodeArray.end());
+  Arrays.insert(Arrays.end(), NodeValues.begin(), NodeValues.end());
+  Arrays.insert(Arrays.end(), NodeFlags.begin(), NodeFlags.end());
+  Arrays.insert(Arrays.end(), Reps.begin(), Reps.end());
+  Arrays.insert(Arrays.end(), NodeSets.begin(), NodeSets.end());
+  Arrays.insert(Arrays.end(), SetBegin.begin(), SetBegin.end());
+  Arrays.insert(Arrays.end(), Elements.begin(), Elements.end());
+  SolvedArrays.swap(Arrays);
+  Solved.map(&SolvedArrays[0]);
+}
+
+/// Freeze - Switch queries to the flattened solution, and free the solver's
+/// graph.  Only ValueNodes and ObjectNodes are kept, to find the nodes of
+/// values.
+void Andersens::Freeze() {
+  PhaseScope Phase(*this, "Freeze");
+  std::vector<Node>().swap(GraphNodes);
+  SetStore.clear();
+  std::map<unsigned, rcs::ValueList>().swap(StorePointees);
+  std::vector<Constraint>().swap(Constraints);
+  DenseMap<Function*, unsigned>().swap(ReturnNodes);
+  DenseMap<Function*, unsigned>().swap(VarargNodes);
+  std::map<unsigned, unsigned>().swap(MaxK);
+  std::vector<unsigned>().swap(Node2DFS);
+  std::vector<bool>().swap(Node2Deleted);
+  std::vector<unsigned>().swap(VSSCCRep);
+  std::vector<bool>().swap(Node2Visited);
+  std::vector<bool>().swap(Node3Visited);
+  std::vector<int>().swap(PEClass2Node);
+  std::vector<int>().swap(PENLEClass2Node);
+  std::vector<unsigned>().swap(HCDSCCRep);
+  std::vector<int>().swap(SDT);
+  std::vector<unsigned>().swap(TopoOrder);
+  std::vector<unsigned>().swap(WaveRep);
+  w1.reset();
+  w2.reset();
+  CurrWL = NextWL = NULL;
+  // The representatives are the same, so the cached results stay valid.
+  Frozen = true;
+}
+
+/// HashModule - Return the fingerprint of M that identifies its snapshots:
+/// the names of the globals, and the opcode and operand count of every
+/// instruction.  Printing the module instead takes seconds on large modules.
+/// The value count from IDAssigner and SolvedGraph::isValid catch the rest.
+uint64_t Andersens::HashModule(Module &M) {
+  rcs::FNVHashStream Hasher;
+  for (Module::global_iterator GV = M.global_begin(); GV != M.global_end();
+       ++GV)
+    Hasher << GV->getName() << '\0';
+  for (Module::alias_iterator GA = M.alias_begin(); GA != M.alias_end(); ++GA)
+    Hasher << GA->getName() << '\0';
+  std::vector<uint32_t> Words;
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    Hasher << F->getName() << '\0';
+    Words.clear();
+    Words.push_back(F->arg_size());
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      Words.push_back(~0U);
+      for (BasicBlock::iterator I = BB->begin(); I != BB->end(); ++I) {
+        Words.push_back(I->getOpcode());
+        Words.push_back(I->getNumOperands());
+      }
+    }
+    Hasher.write(reinterpret_cast<const char *>(&Words[0]),
+                 Words.size() * sizeof(uint32_t));
+  }
+  return Hasher.getHash();
+}
+
+/// WriteSnapshot - Save the flattened solution so that later runs can answer
+/// queries without solving.
+void Andersens::WriteSnapshot(Module &M) {
+  std::string ErrorInfo;
+  raw_fd_ostream Out(SnapshotOut.c_str(), ErrorInfo, raw_fd_ostream::F_Binary);
+  if (!ErrorInfo.empty()) {
+    errs() << ErrorInfo << "\n";
+    return;
+  }
+  SnapshotHeader Header;
+  memcpy(Header.Magic, SnapshotMagic, sizeof(Header.Magic));
+  Header.Version = SnapshotVersion;
+  Header.NumValues = Solved.NumValues;
+  Header.NumNodes = Solved.NumNodes;
+  Header.NumSets = Solved.NumSets;
+  Header.NumElements = Solved.NumElements;
+  Header.Padding = 0;
+  Header.ModuleHash = HashModule(M);
+  Out.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+  WriteArray(Out, SolvedArrays);
+}
+
+void Andersens::WriteArray(raw_ostream &Out, const std::vector<uint32_t> &A) {
+  if (!A.empty())
+    Out.write(reinterpret_cast<const char *>(&A[0]), A.size() * sizeof(A[0]));
+}
+
+/// LoadSnapshot - Map a snapshot written by WriteSnapshot, and answer queries
+/// from it.  Returns false if the snapshot cannot be used for this module.
+bool Andersens::LoadSnapshot(Module &M) {
+  PhaseScope Phase(*this, "LoadSnapshot");
+  OwningPtr<MemoryBuffer> Buffer;
+  // Without a null terminator, MemoryBuffer may map the file instead of
+  // reading it.
+  if (error_code EC = MemoryBuffer::getFile(SnapshotIn, Buffer, -1, false)) {
+    errs() << "Cannot read " << SnapshotIn << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  const char *Start = Buffer->getBufferStart();
+  size_t BufferSize = Buffer->getBufferSize();
+  if (BufferSize < sizeof(SnapshotHeader)) {
+    errs() << SnapshotIn << " is not a snapshot\n";
+    return false;
+  }
+  const SnapshotHeader *Header =
+      reinterpret_cast<const SnapshotHeader *>(Start);
+  if (memcmp(Header->Magic, SnapshotMagic, sizeof(Header->Magic)) ||
+      Header->Version != SnapshotVersion) {
+    errs() << SnapshotIn << " is not a snapshot\n";
+    return false;
+  }
+  if (Header->NumValues != IDA->getNumValues() ||
+      Header->ModuleHash != HashModule(M)) {
+    errs() << SnapshotIn << " is a snapshot of a different module\n";
+    return false;
+  }
+  SolvedGraph G;
+  G.NumValues = Header->NumValues;
+  G.NumNodes = Header->NumNodes;
+  G.NumSets = Header->NumSets;
+  G.NumElements = Header->NumElements;
+  if (BufferSize != sizeof(SnapshotHeader) +
+                    sizeof(uint32_t) * G.getNumWords()) {
+    errs() << SnapshotIn << " is truncated\n";
+    return false;
+  }
+
+  G.map(reinterpret_cast<const uint32_t *>(Header + 1));
+  if (!G.isValid()) {
+    errs() << SnapshotIn << " is corrupt\n";
+    return false;
+  }
+  Solved = G;
+  SnapshotBuffer.swap(Buffer);
+  ClearAliasCache();
+  Frozen = true;
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+//                               Union-Find
+//===----------------------------------------------------------------------===//
+
+// Unite nodes First and Second, returning the one which is now the
+// representative node.  First and Second are indexes into GraphNodes
+unsigned Andersens::UniteNodes(unsigned First, unsigned Second,
+                               bool UnionByRank) {
+  assert (First < GraphNodes.size() && Second < GraphNodes.size() &&
+          "Attempting to merge nodes that don't exist");
+
+  Node *FirstNode = &GraphNodes[First];
+  Node *SecondNode = &GraphNodes[Second];
+
+  assert (SecondNode->isRep() && FirstNode->isRep() &&
+          "Trying to unite two non-representative nodes!");
+  if (First == Second)
+    return First;
+
+  if (UnionByRank) {
+    int RankFirst  = (int) FirstNode ->NodeRep;
     int RankSecond = (int) SecondNode->NodeRep;
 
     // Rank starts at -1 and gets decremented as it increases.
@@ -3041,23 +6077,21 @@ unsigned Andersens::UniteNodes(unsigned First, unsigned Second,
   if (First >= NumberSpecialNodes)
 #endif
     if (FirstNode->PointsTo && SecondNode->PointsTo)
-      FirstNode->PointsTo |= *(SecondNode->PointsTo);
+      UnionPointsTo(FirstNode, *SecondNode->PointsTo);
   if (FirstNode->Edges && SecondNode->Edges)
     FirstNode->Edges |= *(SecondNode->Edges);
   if (!SecondNode->Constraints.empty())
     FirstNode->Constraints.splice(FirstNode->Constraints.begin(),
                                   SecondNode->Constraints);
-  if (FirstNode->OldPointsTo) {
-    delete FirstNode->OldPointsTo;
-    FirstNode->OldPointsTo = new SparseBitVector<>;
-  }
+  if (FirstNode->OldPointsTo)
+    ClearOldPointsTo(FirstNode);
 
   // Destroy interesting parts of the merged-from node.
-  delete SecondNode->OldPointsTo;
+  FreePointsTo(SecondNode);
+  if (SecondNode->OldPointsTo)
+    ClearOldPointsTo(SecondNode);
   delete SecondNode->Edges;
-  delete SecondNode->PointsTo;
   SecondNode->Edges = NULL;
-  SecondNode->PointsTo = NULL;
   SecondNode->OldPointsTo = NULL;
 
   NumUnified++;
@@ -3206,8 +6240,47 @@ void Andersens::PrintConstraints() const {
     PrintConstraint(Constraints[i]);
 }
 
+void Andersens::PrintSolvedNode(unsigned N) const {
+  switch (N) {
+    case UniversalSet: errs() << "<universal>"; return;
+    case NullPtr:      errs() << "<nullptr>"; return;
+    case NullObject:   errs() << "<null>"; return;
+  }
+  errs() << "N" << N << " ";
+  if (Value *V = getSolvedValue(N)) {
+    if (V->hasName())
+      errs() << V->getName();
+    else
+      errs() << "(unnamed)";
+  } else {
+    errs() << "artificial";
+  }
+}
+
 void Andersens::PrintPointsToGraph() const {
   errs() << "Points-to graph:\n";
+  if (Frozen) {
+    for (unsigned i = 0; i < Solved.NumNodes; ++i) {
+      if (Solved.Reps[i] != i) {
+        PrintSolvedNode(i);
+        errs() << "\t--> same as ";
+        PrintSolvedNode(Solved.Reps[i]);
+        errs() << "\n";
+        continue;
+      }
+      errs() << "[" << (Solved.end(i) - Solved.begin(i)) << "] ";
+      PrintSolvedNode(i);
+      errs() << "\t--> ";
+      for (const uint32_t *I = Solved.begin(i), *E = Solved.end(i); I != E;
+           ++I) {
+        if (I != Solved.begin(i))
+          errs() << ", ";
+        PrintSolvedNode(*I);
+      }
+      errs() << "\n";
+    }
+    return;
+  }
   for (unsigned i = 0, e = GraphNodes.size(); i != e; ++i) {
     const Node *N = &GraphNodes[i];
     if (FindNode(i) != i) {
@@ -3215,13 +6288,17 @@ void Andersens::PrintPointsToGraph() const {
       errs() << "\t--> same as ";
       PrintNode(&GraphNodes[FindNode(i)]);
       errs() << "\n";
+    } else if (!N->PointsTo) {
+      // Not queried yet in demand-driven mode.
+      PrintNode(N);
+      errs() << "\t--> (not computed)\n";
     } else {
       errs() << "[" << (N->PointsTo->count()) << "] ";
       PrintNode(N);
       errs() << "\t--> ";
 
       bool first = true;
-      for (SparseBitVector<>::iterator bi = N->PointsTo->begin();
+      for (rcs::HybridBitSet::iterator bi = N->PointsTo->begin();
            bi != N->PointsTo->end();
            ++bi) {
         if (!first)
@@ -0,0 +1,273 @@
+// Class hierarchy analysis (CHA) and rapid type analysis (RTA) on the vtables
+// of a C++ module compiled with the Itanium ABI.
+//
+// A vtable _ZTV<X> is an array of i8*. Constructors store the addresses of
+// its address points, i.e. getelementptr(_ZTV<X>, 0, AP), into objects, and
+// virtual function K of the object is at index AP + K. With multiple
+// inheritance, _ZTV<X> holds one address point per subobject with a vtable,
+// and index AP - 2 holds the offset-to-top of that subobject, i.e. minus its
+// offset in X. A typeinfo _ZTI<X> refers to the typeinfos of the direct
+// bases of X, followed by their offsets unless X has a single base at
+// offset 0. A virtual call through an object of static type X can therefore
+// only call the functions at slot K of the address points for X's subobject
+// in X and its subclasses, in the vtables that are ever stored into objects.
+
+#include <algorithm>
+
+#include "llvm/Instructions.h"
+#include "llvm/Operator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+
+#include "rcs/ClassHierarchy.h"
+
+using namespace std;
+using namespace llvm;
+using namespace rcs;
+
+const int64_t ClassHierarchy::UnknownOffset;
+
+void ClassHierarchy::clear() {
+  Classes.clear();
+}
+
+void ClassHierarchy::build(Module &M) {
+  clear();
+  for (Module::global_iterator GV = M.global_begin(); GV != M.global_end();
+       ++GV) {
+    if (!GV->hasName() || !GV->hasInitializer())
+      continue;
+    StringRef Name = GV->getName();
+
+    if (Name.startswith("_ZTV")) {
+      ConstantArray *Init = dyn_cast<ConstantArray>(GV->getInitializer());
+      if (Init == NULL)
+        continue;
+      ClassInfo &C = Classes[Name.substr(4)];
+      C.VTable = Init;
+      for (Value::use_iterator UI = GV->use_begin(); UI != GV->use_end();
+           ++UI) {
+        GEPOperator *GEP = dyn_cast<GEPOperator>(*UI);
+        if (GEP == NULL || GEP->getPointerOperand() != GV ||
+            GEP->getNumIndices() != 2)
+          continue;
+        ConstantInt *Index = dyn_cast<ConstantInt>(GEP->getOperand(2));
+        if (Index && Index->getZExtValue() < Init->getNumOperands())
+          C.AddressPoints.push_back(Index->getZExtValue());
+      }
+      sort(C.AddressPoints.begin(), C.AddressPoints.end());
+      C.AddressPoints.erase(unique(C.AddressPoints.begin(),
+                                   C.AddressPoints.end()),
+                            C.AddressPoints.end());
+    } else if (Name.startswith("_ZTI")) {
+      // Field 0 is the vtable of the typeinfo class, and field 1 the name.
+      // The base typeinfos follow, possibly mixed with flags and offsets.
+      // In __vmi_class_type_info, each base typeinfo is followed by its
+      // offset shifted left by 8, with bit 0 set for virtual bases.
+      // __si_class_type_info has only the base, at offset 0.
+      Constant *Init = GV->getInitializer();
+      Classes[Name.substr(4)].HasTypeInfo = true;
+      for (unsigned i = 2; i < Init->getNumOperands(); ++i) {
+        GlobalVariable *Base = dyn_cast<GlobalVariable>(
+            Init->getOperand(i)->stripPointerCasts());
+        if (Base == NULL || !Base->getName().startswith("_ZTI"))
+          continue;
+        int64_t Offset = 0;
+        if (i + 1 < Init->getNumOperands()) {
+          ConstantInt *OffsetFlags =
+              dyn_cast<ConstantInt>(Init->getOperand(i + 1));
+          if (OffsetFlags == NULL || (OffsetFlags->getSExtValue() & 1))
+            Offset = UnknownOffset;
+          else
+            Offset = OffsetFlags->getSExtValue() / 256;
+        }
+        Classes[Base->getName().substr(4)].Derived.push_back(
+            make_pair(Name.substr(4).str(), Offset));
+      }
+    }
+  }
+}
+
+// Returns the mangled name of the class <T> points to, or "" if <T> is not a
+// pointer to a class we know how to mangle.
+string ClassHierarchy::getMangledName(Type *T) {
+  PointerType *PT = dyn_cast<PointerType>(T);
+  if (PT == NULL)
+    return "";
+  StructType *ST = dyn_cast<StructType>(PT->getElementType());
+  if (ST == NULL || !ST->hasName())
+    return "";
+
+  StringRef Name = ST->getName();
+  if (Name.startswith("class."))
+    Name = Name.substr(6);
+  else if (Name.startswith("struct."))
+    Name = Name.substr(7);
+  else
+    return "";
+  // Drop the suffixes of renamed types and base subobjects, e.g. ".base".
+  Name = Name.substr(0, Name.find('.'));
+  // Templates and anonymous namespaces.
+  if (Name.find_first_of("<>() ") != StringRef::npos)
+    return "";
+
+  SmallVector<StringRef, 4> Parts;
+  Name.split(Parts, "::");
+  string Result;
+  for (size_t i = 0; i < Parts.size(); ++i) {
+    if (Parts[i].empty())
+      return "";
+    Result += utostr(Parts[i].size());
+    Result += Parts[i];
+  }
+  if (Parts.size() > 1)
+    Result = "N" + Result + "E";
+  return Result;
+}
+
+// Matches FP = load (getelementptr (load Object), Slot), the way virtual
+// function pointers are loaded. The getelementptr is absent for slot 0.
+bool ClassHierarchy::getVTableSlot(Value *FP, Value *&Object, unsigned &Slot) {
+  LoadInst *FuncLoad = dyn_cast<LoadInst>(FP);
+  if (FuncLoad == NULL)
+    return false;
+
+  Value *Addr = FuncLoad->getPointerOperand();
+  Slot = 0;
+  if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(Addr)) {
+    if (GEP->getNumIndices() != 1)
+      return false;
+    ConstantInt *Index = dyn_cast<ConstantInt>(GEP->getOperand(1));
+    if (Index == NULL)
+      return false;
+    Slot = Index->getZExtValue();
+    Addr = GEP->getPointerOperand();
+  }
+
+  LoadInst *VTableLoad = dyn_cast<LoadInst>(Addr);
+  if (VTableLoad == NULL)
+    return false;
+  Object = VTableLoad->getPointerOperand();
+  // Strip bitcasts only. A getelementptr to a base subobject would give us
+  // the derived class, whose subclasses are not all the possible types.
+  while (BitCastInst *BC = dyn_cast<BitCastInst>(Object))
+    Object = BC->getOperand(0);
+  return true;
+}
+
+// Reads the offset-to-top entry of address point <AddressPoint> of <C>'s
+// vtable.
+bool ClassHierarchy::getOffsetToTop(const ClassInfo &C, unsigned AddressPoint,
+                                    int64_t &Offset) {
+  if (AddressPoint < 2)
+    return false;
+  Constant *Entry = C.VTable->getOperand(AddressPoint - 2);
+  if (Entry->isNullValue()) {
+    Offset = 0;
+    return true;
+  }
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(Entry);
+  if (CE == NULL || CE->getOpcode() != Instruction::IntToPtr)
+    return false;
+  ConstantInt *OffsetToTop = dyn_cast<ConstantInt>(CE->getOperand(0));
+  if (OffsetToTop == NULL)
+    return false;
+  Offset = OffsetToTop->getSExtValue();
+  return true;
+}
+
+// Collects <Name> and its subclasses into <Result>, with the offset of the
+// subobject of the static class in each, given that it is at <Offset> in
+// <Name>. Returns false if the module lacks the vtable of any of them, since
+// the class may then have overriders we cannot see, or if a subclass has the
+// static class at an unknown offset or at several offsets.
+bool ClassHierarchy::collectSubclasses(
+    const string &Name, int64_t Offset, StringMap<int64_t> &Visited,
+    vector<pair<const ClassInfo *, int64_t> > &Result) const {
+  if (Offset == UnknownOffset)
+    return false;
+  StringMap<int64_t>::iterator V = Visited.find(Name);
+  if (V != Visited.end())
+    return V->second == Offset;
+  Visited[Name] = Offset;
+  StringMap<ClassInfo>::const_iterator I = Classes.find(Name);
+  if (I == Classes.end() || I->second.VTable == NULL)
+    return false;
+  Result.push_back(make_pair(&I->second, Offset));
+  const vector<pair<string, int64_t> > &Derived = I->second.Derived;
+  for (size_t i = 0; i < Derived.size(); ++i) {
+    int64_t SubOffset = (Derived[i].second == UnknownOffset ?
+                         UnknownOffset : Offset + Derived[i].second);
+    if (!collectSubclasses(Derived[i].first, SubOffset, Visited, Result))
+      return false;
+  }
+  return true;
+}
+
+// Adds the function at slot <Slot> of the address point of <C>'s vtable for
+// the subobject at <Offset>. Returns false if <C> has no vtable, or <C> is
+// instantiated but has no or several address points for that subobject.
+bool ClassHierarchy::addCallees(const ClassInfo &C, int64_t Offset,
+                                unsigned Slot, unsigned NumArgs,
+                                FuncList &Callees) {
+  if (C.VTable == NULL)
+    return false;
+  if (C.AddressPoints.empty())
+    return true;
+  unsigned Index = 0, NumMatches = 0;
+  for (size_t i = 0; i < C.AddressPoints.size(); ++i) {
+    int64_t OffsetToTop;
+    if (!getOffsetToTop(C, C.AddressPoints[i], OffsetToTop))
+      return false;
+    if (OffsetToTop == -Offset) {
+      Index = C.AddressPoints[i] + Slot;
+      ++NumMatches;
+    }
+  }
+  if (NumMatches != 1)
+    return false;
+  if (Index >= C.VTable->getNumOperands())
+    return true;
+  Function *F = dyn_cast<Function>(
+      C.VTable->getOperand(Index)->stripPointerCasts());
+  // Skip external functions (e.g. __cxa_pure_virtual) as FPCallGraph does.
+  if (F == NULL || F->isDeclaration())
+    return true;
+  if (F->isVarArg() ? F->arg_size() > NumArgs : F->arg_size() != NumArgs)
+    return true;
+  Callees.push_back(F);
+  return true;
+}
+
+bool ClassHierarchy::getVirtualCallees(const CallSite &CS,
+                                       FuncList &Callees) const {
+  Value *Object;
+  unsigned Slot;
+  if (!getVTableSlot(CS.getCalledValue(), Object, Slot))
+    return false;
+  // Only classes with a typeinfo in the module. Otherwise, the load may well
+  // be from a C table of function pointers, and we would not know all the
+  // subclasses anyway.
+  string Name = getMangledName(Object->getType());
+  if (Name.empty())
+    return false;
+  StringMap<ClassInfo>::const_iterator I = Classes.find(Name);
+  if (I == Classes.end() || !I->second.HasTypeInfo)
+    return false;
+
+  StringMap<int64_t> Visited;
+  vector<pair<const ClassInfo *, int64_t> > Subclasses;
+  if (!collectSubclasses(Name, 0, Visited, Subclasses))
+    return false;
+  // Leave <Callees> untouched when falling back to the generic path.
+  FuncList Found;
+  for (size_t i = 0; i < Subclasses.size(); ++i) {
+    if (!addCallees(*Subclasses[i].first, Subclasses[i].second, Slot,
+                    CS.arg_size(), Found))
+      return false;
+  }
+  if (Found.empty())
+    return false;
+  Callees.insert(Callees.end(), Found.begin(), Found.end());
+  return true;
+}
@@ -1,6 +1,5 @@
 #include "llvm/Support/CFG.h"
 #include "llvm/ADT/DenseSet.h"
-#include "llvm/ADT/SCCIterator.h"
 using namespace llvm;
 
 #include "rcs/Exec.h"
@@ -34,7 +33,7 @@ bool Exec::is_landmark(const Instruction *ins) const {
 
 void Exec::dfs(const Function *f, ConstFuncMapping &parent) {
   FPCallGraph &CG = getAnalysis<FPCallGraph>();
-  const InstList &call_sites = CG.getCallSites(f);
+  ArrayRef<Instruction *> call_sites = CG.getCallSites(f);
   for (size_t i = 0; i < call_sites.size(); ++i) {
     Function *caller = call_sites[i]->getParent()->getParent();
     if (!parent.count(caller)) {
@@ -72,14 +71,14 @@ bool Exec::runOnModule(Module &M) {
 }
 
 void Exec::compute_must_exec() {
-  CallGraph &CG = getAnalysis<FPCallGraph>();
-  for (scc_iterator<CallGraph *> si = scc_begin(&CG), E = scc_end(&CG);
-       si != E; ++si) {
-    for (size_t i = 0; i < (*si).size(); ++i) {
-      if (Function *f = (*si)[i]->getFunction()) {
-        if (f && !f->isDeclaration() && compute_must_exec(f))
-          must_exec.insert(f);
-      }
+  // Bottom-up on the SCCs of the call graph.
+  FPCallGraph &CG = getAnalysis<FPCallGraph>();
+  for (unsigned i = 0, E = CG.getNumSCCs(); i < E; ++i) {
+    ArrayRef<Function *> scc = CG.getSCC(i);
+    for (size_t j = 0; j < scc.size(); ++j) {
+      Function *f = scc[j];
+      if (!f->isDeclaration() && compute_must_exec(f))
+        must_exec.insert(f);
     }
   }
 }
@@ -103,7 +102,7 @@ bool Exec::may_exec_landmark(const Instruction *ins) const {
     return false;
 
   FPCallGraph &CG = getAnalysis<FPCallGraph>();
-  FuncList callees = CG.getCalledFunctions(ins);
+  ArrayRef<Function *> callees = CG.getCalledFunctions(ins);
   for (size_t i = 0; i < callees.size(); ++i) {
     if (may_exec_landmark(callees[i]))
       return true;
@@ -119,7 +118,7 @@ bool Exec::must_exec_landmark(const Instruction *ins) const {
 
   FPCallGraph &CG = getAnalysis<FPCallGraph>();
 
-  FuncList callees = CG.getCalledFunctions(ins);
+  ArrayRef<Function *> callees = CG.getCalledFunctions(ins);
   bool all_must_exec = true;
   for (size_t i = 0; i < callees.size(); ++i) {
     if (!must_exec_landmark(callees[i])) {
@@ -140,7 +139,7 @@ bool Exec::compute_must_exec(const BasicBlock *bb) {
     if (landmarks.count(ins))
       return true;
     if (is_call(ins)) {
-      FuncList callees = CG.getCalledFunctions(ins);
+      ArrayRef<Function *> callees = CG.getCalledFunctions(ins);
       bool all_must_exec = true;
       for (size_t i = 0; i < callees.size(); ++i) {
         if (!must_exec.count(callees[i])) {
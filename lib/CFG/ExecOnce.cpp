@@ -73,21 +73,19 @@ void ExecOnce::identify_starting_funcs(Module &M, FuncSet &starts) {
   starts.clear();
   // Identify reachable recursive functions. 
   FPCallGraph &CG = getAnalysis<FPCallGraph>();
-  CallGraph &raw_CG = CG;
-  for (scc_iterator<CallGraph *> si = scc_begin(&raw_CG),
-       E = scc_end(&raw_CG); si != E; ++si) {
-    if (si.hasLoop()) {
-      for (size_t i = 0; i < (*si).size(); ++i) {
-        Function *f = (*si)[i]->getFunction();
-        if (f && !not_executed(f))
-          starts.insert(f);
+  for (unsigned i = 0, E = CG.getNumSCCs(); i < E; ++i) {
+    if (CG.sccHasLoop(i)) {
+      ArrayRef<Function *> scc = CG.getSCC(i);
+      for (size_t j = 0; j < scc.size(); ++j) {
+        if (!not_executed(scc[j]))
+          starts.insert(scc[j]);
       }
     }
   } // for scc
 
   // Identify functions that are called by multiple reachable call sites. 
   forallfunc(M, fi) {
-    InstList call_sites = CG.getCallSites(fi);
+    ArrayRef<Instruction *> call_sites = CG.getCallSites(fi);
     unsigned n_reachable_call_sites = 0;
     for (size_t j = 0; j < call_sites.size(); ++j) {
       Instruction *call_site = call_sites[j];
@@ -103,7 +101,7 @@ void ExecOnce::identify_starting_funcs(Module &M, FuncSet &starts) {
     BasicBlock *bb = *it;
     forall(BasicBlock, ii, *bb) {
       if (is_call(ii)) {
-        FuncList callees = CG.getCalledFunctions(ii);
+        ArrayRef<Function *> callees = CG.getCalledFunctions(ii);
         for (size_t j = 0; j < callees.size(); ++j)
           starts.insert(callees[j]);
       }
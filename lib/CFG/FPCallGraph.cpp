@@ -1,15 +1,39 @@
 // A call-graph builder considering function pointers.
-// The targets of function pointers are identified by alias analysis.
+// The targets of function pointers are identified by alias analysis, or by
+// PointerAnalysis with -fpcg-use-pa.
 // Users may specify which alias analysis she wants to run this pass with.
 
+#define DEBUG_TYPE "fpcg"
+
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
 
+#include "rcs/AnalysisOptions.h"
+#include "rcs/FNVHashStream.h"
 #include "rcs/FPCallGraph.h"
+#include "rcs/IDAssigner.h"
+#include "rcs/Parallel.h"
+#include "rcs/PointerAnalysis.h"
 #include "rcs/util.h"
 
 using namespace std;
@@ -21,11 +45,64 @@ static RegisterPass<FPCallGraph> X("fpcg",
                          false, true);
 static RegisterAnalysisGroup<CallGraph> Y(X);
 
+static cl::opt<bool> IgnoreArity("fpcg-ignore-arity",
+                                 cl::desc("Consider every address-taken "
+                                          "function as a target of every "
+                                          "indirect call. Use it for "
+                                          "programs that call functions "
+                                          "through casts"));
+
+static cl::opt<bool> UsePA("fpcg-use-pa",
+                           cl::desc("Resolve indirect calls with the pointees "
+                                    "given by PointerAnalysis, and ask alias "
+                                    "analysis only about pointers without "
+                                    "point-to information"));
+static cl::opt<bool> UseCHA("fpcg-cha",
+                            cl::desc("Resolve C++ virtual calls with the "
+                                     "class hierarchy and the vtables in the "
+                                     "module before asking other analyses"));
+static cl::opt<bool> ReportTime("fpcg-time",
+                                cl::desc("Print the time spent resolving "
+                                         "call sites"));
+
+static cl::opt<string> CacheDir("fpcg-cache-dir",
+                                cl::desc("Directory of call graph caches. "
+                                         "Loads the edges from the cache of "
+                                         "the same module and options "
+                                         "instead of resolving call sites, "
+                                         "or writes the cache on a miss"));
+static cl::opt<unsigned> NumThreads("fpcg-threads",
+                                    cl::desc("Number of threads resolving "
+                                             "call sites with -fpcg-use-pa. "
+                                             "Only used if PointerAnalysis "
+                                             "is thread-safe, e.g. a frozen "
+                                             "anders-pa"),
+                                    cl::init(1));
+static cl::opt<bool> CheckUpdate("fpcg-check-update",
+                                 cl::desc("Re-resolve every other function "
+                                          "with updateFunctions after "
+                                          "building the call graph, and "
+                                          "check that no edge changes"));
+
+STATISTIC(NumAliasQueries, "Number of alias queries for indirect calls");
+STATISTIC(NumResolvedByCHA, "Number of virtual calls resolved by the class "
+                            "hierarchy");
+STATISTIC(NumResolvedByPA, "Number of indirect calls resolved by "
+                           "PointerAnalysis");
+STATISTIC(NumPAFallbacks, "Number of indirect calls PointerAnalysis has no "
+                          "information for");
+
 char FPCallGraph::ID = 0;
 
 void FPCallGraph::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
-  AU.addRequired<AliasAnalysis>();
+  // updateFunctions queries them after runOnModule.
+  AU.addRequiredTransitive<AliasAnalysis>();
+  if (UsePA)
+    AU.addRequiredTransitive<PointerAnalysis>();
+  // The cache identifies call sites and functions by their IDs.
+  if (!CacheDir.empty())
+    AU.addRequired<IDAssigner>();
 }
 
 void *FPCallGraph::getAdjustedAnalysisPointer(AnalysisID PI) {
@@ -34,10 +111,18 @@ void *FPCallGraph::getAdjustedAnalysisPointer(AnalysisID PI) {
   return this;
 }
 
-FPCallGraph::FPCallGraph(): ModulePass(ID) {
+FPCallGraph::FPCallGraph(): ModulePass(ID), SCCOffsets(1, 0) {
   Root = NULL;
+  AA = NULL;
+  PA = NULL;
   ExternCallingNode = NULL;
   CallsExternNode = NULL;
+  pthread_mutex_init(&AAMutex, NULL);
+  LockAA = false;
+}
+
+FPCallGraph::~FPCallGraph() {
+  pthread_mutex_destroy(&AAMutex);
 }
 
 void FPCallGraph::destroy() {
@@ -63,55 +148,244 @@ void FPCallGraph::MakeUnique(vector<T> &V) {
   V.erase(unique(V.begin(), V.end()), V.end());
 }
 
-FuncList FPCallGraph::getCalledFunctions(
+ArrayRef<Function *> FPCallGraph::getCalledFunctions(
     const Instruction *Ins) const {
-  SiteToFuncsMapTy::const_iterator I = SiteToFuncs.find(Ins);
-  if (I == SiteToFuncs.end())
-    return FuncList();
-  return I->second;
+  DenseMap<const Instruction *, unsigned>::const_iterator I =
+      SiteIDs.find(Ins);
+  if (I == SiteIDs.end())
+    return ArrayRef<Function *>();
+  unsigned Begin = CalleeOffsets[I->second];
+  unsigned End = CalleeOffsets[I->second + 1];
+  return ArrayRef<Function *>(&SiteCallees[Begin], End - Begin);
 }
 
-InstList FPCallGraph::getCallSites(
+ArrayRef<Instruction *> FPCallGraph::getCallSites(
     const Function *F) const {
-  FuncToSitesMapTy::const_iterator I = FuncToSites.find(F);
-  if (I == FuncToSites.end())
-    return InstList();
-  return I->second;
+  DenseMap<const Function *, unsigned>::const_iterator I = FuncIDs.find(F);
+  if (I == FuncIDs.end())
+    return ArrayRef<Instruction *>();
+  unsigned Begin = CallSiteOffsets[I->second];
+  unsigned End = CallSiteOffsets[I->second + 1];
+  return ArrayRef<Instruction *>(&FuncCallSites[Begin], End - Begin);
+}
+
+bool FPCallGraph::mayPointTo(Value *FP, Function *F) {
+  ++NumAliasQueries;
+  if (!LockAA)
+    return AA->alias(FP, F);
+  pthread_mutex_lock(&AAMutex);
+  bool Result = AA->alias(FP, F);
+  pthread_mutex_unlock(&AAMutex);
+  return Result;
 }
 
-void FPCallGraph::processCallSite(const CallSite &CS, const FuncSet &AllFuncs) {
-  AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
+// <FP> is called with <NumArgs> arguments, and may target functions with
+// <MinArgs> to <NumArgs> parameters.
+void FPCallGraph::getIndirectCallees(Value *FP, unsigned MinArgs,
+                                     unsigned NumArgs, FuncList &Callees) {
+  if (getCalleesFromPA(FP, Callees))
+    return;
+
+  if (IgnoreArity) {
+    for (FuncList::const_iterator I = AddressTakenFuncs.begin();
+         I != AddressTakenFuncs.end(); ++I) {
+      if (mayPointTo(FP, *I))
+        Callees.push_back(*I);
+    }
+    return;
+  }
+
+  for (unsigned Arity = MinArgs; Arity <= NumArgs; ++Arity) {
+    DenseMap<unsigned, FuncList>::const_iterator Bucket =
+        FuncsByArity.find(Arity);
+    if (Bucket == FuncsByArity.end())
+      continue;
+    for (FuncList::const_iterator I = Bucket->second.begin();
+         I != Bucket->second.end(); ++I) {
+      if (mayPointTo(FP, *I))
+        Callees.push_back(*I);
+    }
+  }
+  for (FuncList::const_iterator I = VarArgFuncs.begin();
+       I != VarArgFuncs.end(); ++I) {
+    if ((*I)->arg_size() > NumArgs)
+      continue;
+    if (mayPointTo(FP, *I))
+      Callees.push_back(*I);
+  }
+}
+
+// Appends the functions PointerAnalysis says <FP> may point to. Returns
+// false if -fpcg-use-pa is off or PointerAnalysis knows nothing about <FP>.
+bool FPCallGraph::getCalleesFromPA(Value *FP, FuncList &Callees) {
+  if (!UsePA)
+    return false;
+  ArrayRef<Value *> Pointees;
+  if (!PA->getPointeeRange(FP, Pointees)) {
+    ++NumPAFallbacks;
+    return false;
+  }
+  ++NumResolvedByPA;
+  for (size_t i = 0; i < Pointees.size(); ++i) {
+    // Skip external functions, like the candidates for alias analysis.
+    Function *F = dyn_cast<Function>(Pointees[i]);
+    if (F && !F->isDeclaration())
+      Callees.push_back(F);
+  }
+  return true;
+}
 
+// Runs the steps resolveCallSite tries before alias analysis on <FP>, which
+// <CS> calls through: the class hierarchy, and then PointerAnalysis.
+// Returns false if both give up.
+bool FPCallGraph::resolveWithoutAA(const CallSite &CS, Value *FP,
+                                   FuncList &Callees) {
+  if (UseCHA && !CS.getCalledFunction()) {
+    if (CHA.getVirtualCallees(CS, Callees)) {
+      ++NumResolvedByCHA;
+      return true;
+    }
+  }
+  return getCalleesFromPA(FP, Callees);
+}
+
+// Does not modify the call graph, so that call sites can be resolved in
+// parallel. The callees are appended to <Callees> in the order they used to
+// be added to the call graph.
+void FPCallGraph::resolveCallSite(const CallSite &CS, FuncList &Callees) {
   if (Function *Callee = CS.getCalledFunction()) {
     // Ignore calls to intrinsic functions.
     // CallGraph would throw assertion failures.
     if (!Callee->isIntrinsic()) {
-      addCallEdge(CS, Callee);
+      Callees.push_back(Callee);
       const Instruction *Ins = CS.getInstruction();
       if (is_pthread_create(Ins)) {
         // Add edge: Ins => the thread function
         Value *Target = get_pthread_create_callee(Ins);
         if (Function *ThrFunc = dyn_cast<Function>(Target)) {
           // pthread_create with a known function
-          addCallEdge(CS, ThrFunc);
+          Callees.push_back(ThrFunc);
         } else {
-          // Ask AA which functions <target> may point to.
-          for (FuncSet::const_iterator I = AllFuncs.begin();
-               I != AllFuncs.end(); ++I) {
-            if (AA.alias(Target, *I))
-              addCallEdge(CS, *I);
-          }
+          // Ask AA which functions <target> may point to. Thread functions
+          // take one argument, which they may leave out.
+          getIndirectCallees(Target, 0, 1, Callees);
         }
       }
     }
   } else {
     Value *FP = CS.getCalledValue();
     assert(FP && "Cannot find the function pointer");
+    if (UseCHA) {
+      if (CHA.getVirtualCallees(CS, Callees)) {
+        ++NumResolvedByCHA;
+        return;
+      }
+    }
     // Ask AA which functions <fp> may point to.
-    for (FuncSet::const_iterator I = AllFuncs.begin();
-         I != AllFuncs.end(); ++I) {
-      if (AA.alias(FP, *I))
-        addCallEdge(CS, *I);
+    getIndirectCallees(FP, CS.arg_size(), CS.arg_size(), Callees);
+  }
+}
+
+// Resolves call site <I> of <Sites> on worker thread <ThreadID>, and records
+// (site index, callee) pairs in the thread's own buffer.
+struct FPCallGraph::ResolveBody {
+  ResolveBody(FPCallGraph &G, const InstList &S, unsigned NumThreads):
+      Graph(G), Sites(S), Buffers(NumThreads) {}
+
+  void operator()(size_t I, unsigned ThreadID) {
+    FuncList Callees;
+    Graph.resolveCallSite(CallSite(Sites[I]), Callees);
+    for (size_t j = 0; j < Callees.size(); ++j)
+      Buffers[ThreadID].push_back(make_pair((unsigned)I, Callees[j]));
+  }
+
+  FPCallGraph &Graph;
+  const InstList &Sites;
+  vector<vector<pair<unsigned, Function *> > > Buffers;
+};
+
+static bool CompareSiteIndex(const pair<unsigned, Function *> &A,
+                             const pair<unsigned, Function *> &B) {
+  return A.first < B.first;
+}
+
+// Workers may share PointerAnalysis only if it is read-only. Without
+// -fpcg-use-pa, every query goes to alias analysis, one at a time, so extra
+// threads would only wait.
+bool FPCallGraph::canResolveInParallel() {
+  return NumThreads > 1 && PA != NULL && PA->isThreadSafe();
+}
+
+void FPCallGraph::resolveCallSitesInParallel(const InstList &Sites) {
+  ResolveBody Body(*this, Sites, NumThreads);
+  LockAA = true;
+  ParallelFor(NumThreads, Sites.size(), Body);
+  LockAA = false;
+
+  // Add the edges in the order of the call sites. A call site is resolved by
+  // only one thread, so the stable sort keeps its callees in the order
+  // resolveCallSite found them. The result is the same as a serial run.
+  vector<pair<unsigned, Function *> > Edges;
+  for (size_t i = 0; i < Body.Buffers.size(); ++i) {
+    Edges.insert(Edges.end(), Body.Buffers[i].begin(), Body.Buffers[i].end());
+    vector<pair<unsigned, Function *> >().swap(Body.Buffers[i]);
+  }
+  stable_sort(Edges.begin(), Edges.end(), CompareSiteIndex);
+  for (size_t i = 0; i < Edges.size(); ++i)
+    addCallEdge(CallSite(Sites[Edges[i].first]), Edges[i].second);
+}
+
+/*
+ * Get the set of all defined functions whose addresses are taken.
+ * Will be used as a candidate set for point-to analysis.
+ * FIXME: Currently we have to skip external functions, otherwise
+ * bc2bdd would fail. Don't ask me why.
+ */
+void FPCallGraph::collectCandidates(Module &M, const FuncSet &Removed) {
+  AddressTakenFuncs.clear();
+  FuncsByArity.clear();
+  VarArgFuncs.clear();
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    if (F->isDeclaration() || !F->hasAddressTaken() || Removed.count(F))
+      continue;
+    AddressTakenFuncs.push_back(F);
+    if (F->isVarArg())
+      VarArgFuncs.push_back(F);
+    else
+      FuncsByArity[F->arg_size()].push_back(F);
+  }
+}
+
+void FPCallGraph::resolveCallSites(Module &M) {
+  if (UseCHA)
+    CHA.build(M);
+  // Look up the analyses before spawning threads.
+  AA = &getAnalysis<AliasAnalysis>();
+  PA = (UsePA ? &getAnalysis<PointerAnalysis>() : NULL);
+  if (canResolveInParallel()) {
+    InstList Sites;
+    for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+      for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+        for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+          if (CallSite(Ins).getInstruction())
+            Sites.push_back(Ins);
+        }
+      }
+    }
+    resolveCallSitesInParallel(Sites);
+  } else {
+    for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+      for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+        for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+          CallSite CS(Ins);
+          if (CS.getInstruction()) {
+            FuncList Callees;
+            resolveCallSite(CS, Callees);
+            for (size_t i = 0; i < Callees.size(); ++i)
+              addCallEdge(CS, Callees[i]);
+          }
+        }
+      }
     }
   }
 }
@@ -129,17 +403,7 @@ bool FPCallGraph::runOnModule(Module &M) {
   for (Module::iterator F = M.begin(); F != M.end(); ++F)
     getOrInsertFunction(F);
 
-  /*
-   * Get the set of all defined functions.
-   * Will be used as a candidate set for point-to analysis.
-   * FIXME: Currently we have to skip external functions, otherwise
-   * bc2bdd would fail. Don't ask me why.
-   */
-  FuncSet AllFuncs;
-  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
-    if (!F->isDeclaration())
-      AllFuncs.insert(F);
-  }
+  collectCandidates(M, FuncSet());
 
   /* Get Root (main function) */
   unsigned NumMains = 0;
@@ -172,34 +436,538 @@ bool FPCallGraph::runOnModule(Module &M) {
   }
 
   // Build the call graph.
+  TimeRecord Start = TimeRecord::getCurrentTime(true);
   SiteToFuncs.clear();
   FuncToSites.clear();
+  uint64_t CacheKey = 0;
+  bool Cached = false;
+  if (!CacheDir.empty()) {
+    CacheKey = computeCacheKey(M);
+    Cached = loadCache(CacheKey);
+  }
+  if (!Cached)
+    resolveCallSites(M);
+
+  // Remove duplicated edges, and pack the edges into the CSR arrays.
+  finalizeCallGraph(M);
+  computeSCCs();
+  CHA.clear();
+  if (!CacheDir.empty() && !Cached)
+    writeCache(M, CacheKey);
+  if (ReportTime) {
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+    double Seconds = End.getWallTime() - Start.getWallTime();
+    if (Cached) {
+      errs() << "Loaded call sites from " << getCachePath(CacheKey)
+          << " in " << format("%.3f", Seconds) << " s\n";
+    } else {
+      unsigned Threads = (canResolveInParallel() ? (unsigned)NumThreads : 1);
+      errs() << "Resolved call sites using "
+          << (UsePA ? "PointerAnalysis" : "alias analysis") << " in "
+          << format("%.3f", Seconds) << " s with " << Threads
+          << " thread(s)\n";
+    }
+  }
+  if (CheckUpdate)
+    checkUpdate(M);
+
+  return false;
+}
+
+// Re-resolves every other defined function through updateFunctions, so that
+// both the changed and the untouched paths run, and checks that the edges
+// match the ones just built.
+void FPCallGraph::checkUpdate(Module &M) {
+  vector<pair<Instruction *, FuncList> > Edges;
+  FuncSet Changed;
+  bool Odd = false;
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    if (F->isDeclaration())
+      continue;
+    if (Odd)
+      Changed.insert(F);
+    Odd = !Odd;
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+        ArrayRef<Function *> Callees = getCalledFunctions(Ins);
+        if (!Callees.empty()) {
+          Edges.push_back(pair<Instruction *, FuncList>(
+                  Ins, FuncList(Callees.begin(), Callees.end())));
+        }
+      }
+    }
+  }
+
+  updateFunctions(M, Changed, FuncSet());
+
+  unsigned NumSites = 0;
   for (Module::iterator F = M.begin(); F != M.end(); ++F) {
     for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
       for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
-        CallSite CS(Ins);
-        if (CS.getInstruction())
-          processCallSite(CS, AllFuncs);
+        if (!getCalledFunctions(Ins).empty())
+          ++NumSites;
       }
     }
   }
+  bool Same = (NumSites == Edges.size());
+  for (size_t i = 0; Same && i < Edges.size(); ++i) {
+    ArrayRef<Function *> Callees = getCalledFunctions(Edges[i].first);
+    Same = (Callees.size() == Edges[i].second.size() &&
+            equal(Callees.begin(), Callees.end(), Edges[i].second.begin()));
+  }
+  if (!Same)
+    report_fatal_error("updateFunctions changed the edges of the call graph");
+}
 
-  // Simplify the call graph.
-  simplifyCallGraph();
+// Returns the function pointer <CS> calls through, or NULL if <CS> calls
+// a known function. For pthread_create, that is the thread function. The
+// targets may have <MinArgs> to <NumArgs> parameters, as in
+// getIndirectCallees.
+static Value *getCalledPointer(const CallSite &CS, unsigned &MinArgs,
+                               unsigned &NumArgs) {
+  if (Function *Callee = CS.getCalledFunction()) {
+    if (Callee->isIntrinsic() || !is_pthread_create(CS.getInstruction()))
+      return NULL;
+    Value *Target = get_pthread_create_callee(CS.getInstruction());
+    if (isa<Function>(Target))
+      return NULL;
+    MinArgs = 0;
+    NumArgs = 1;
+    return Target;
+  }
+  MinArgs = NumArgs = CS.arg_size();
+  return CS.getCalledValue();
+}
 
-  return false;
+// The same arity filter the candidate buckets implement.
+static bool mayCallWithArity(const Function *F, unsigned MinArgs,
+                             unsigned NumArgs) {
+  if (IgnoreArity)
+    return true;
+  if (F->isVarArg())
+    return F->arg_size() <= NumArgs;
+  return F->arg_size() >= MinArgs && F->arg_size() <= NumArgs;
 }
 
-void FPCallGraph::simplifyCallGraph() {
-  // Remove duplicated items in each vector.
+void FPCallGraph::rebuildCallEdges(Function *F) {
+  CallGraphNode *Node = getOrInsertFunction(F);
+  Node->removeAllCalledFunctions();
+  if (F->isDeclaration())
+    Node->addCalledFunction(CallSite(), CallsExternNode);
+  for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+    for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+      SiteToFuncsMapTy::iterator I = SiteToFuncs.find(Ins);
+      if (I == SiteToFuncs.end())
+        continue;
+      for (size_t i = 0; i < I->second.size(); ++i) {
+        Node->addCalledFunction(CallSite(Ins),
+                                getOrInsertFunction(I->second[i]));
+      }
+    }
+  }
+}
+
+void FPCallGraph::updateFunctions(Module &M, const FuncSet &Changed,
+                                  const FuncSet &Removed) {
+  TimeRecord Start = TimeRecord::getCurrentTime(true);
+  if (UseCHA)
+    CHA.build(M);
+  AA = &getAnalysis<AliasAnalysis>();
+  PA = (UsePA ? &getAnalysis<PointerAnalysis>() : NULL);
+
+  // Functions whose membership in the candidate set changed.
+  FuncList OldCandidates(AddressTakenFuncs);
+  collectCandidates(M, Removed);
+  FuncList NewCandidates(AddressTakenFuncs);
+  MakeUnique(OldCandidates);
+  MakeUnique(NewCandidates);
+  FuncList Gone, Added;
+  set_difference(OldCandidates.begin(), OldCandidates.end(),
+                 NewCandidates.begin(), NewCandidates.end(),
+                 back_inserter(Gone));
+  set_difference(NewCandidates.begin(), NewCandidates.end(),
+                 OldCandidates.begin(), OldCandidates.end(),
+                 back_inserter(Added));
+  FuncSet NoLongerCallable(Removed);
+  for (size_t i = 0; i < Gone.size(); ++i)
+    NoLongerCallable.insert(Gone[i]);
+
+  // Move the edges of the untouched functions back into the maps. Only look
+  // up their instructions: the changed functions may have freed theirs.
+  // Indirect call sites that the class hierarchy or PointerAnalysis resolve
+  // are resolved by them again, as a full rebuild would. The others drop the
+  // callees that are no longer candidates, and ask alias analysis about the
+  // new candidates only.
+  SiteToFuncs.clear();
+  FuncList Dirty;
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    if (Changed.count(F) || Removed.count(F))
+      continue;
+    bool EdgesChanged = false;
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+        CallSite CS(Ins);
+        if (!CS.getInstruction())
+          continue;
+        ArrayRef<Function *> OldCallees = getCalledFunctions(Ins);
+        unsigned MinArgs = 0, NumArgs = 0;
+        Value *FP = getCalledPointer(CS, MinArgs, NumArgs);
+        FuncList Callees, Resolved;
+        if (FP && resolveWithoutAA(CS, FP, Resolved)) {
+          // Keep the direct callee, i.e. pthread_create.
+          if (Function *Callee = CS.getCalledFunction())
+            Callees.push_back(Callee);
+          for (size_t i = 0; i < Resolved.size(); ++i) {
+            if (!Removed.count(Resolved[i]))
+              Callees.push_back(Resolved[i]);
+          }
+          MakeUnique(Callees);
+          if (Callees.size() != OldCallees.size() ||
+              !equal(Callees.begin(), Callees.end(), OldCallees.begin()))
+            EdgesChanged = true;
+          if (!Callees.empty())
+            SiteToFuncs[Ins].swap(Callees);
+          continue;
+        }
+        for (size_t i = 0; i < OldCallees.size(); ++i) {
+          if (FP && NoLongerCallable.count(OldCallees[i]))
+            EdgesChanged = true;
+          else
+            Callees.push_back(OldCallees[i]);
+        }
+        if (FP) {
+          for (size_t i = 0; i < Added.size(); ++i) {
+            if (!mayCallWithArity(Added[i], MinArgs, NumArgs))
+              continue;
+            if (mayPointTo(FP, Added[i])) {
+              Callees.push_back(Added[i]);
+              EdgesChanged = true;
+            }
+          }
+        }
+        if (!Callees.empty())
+          SiteToFuncs[Ins].swap(Callees);
+      }
+    }
+    if (EdgesChanged)
+      Dirty.push_back(F);
+  }
+
+  // Re-resolve the call sites of the changed functions.
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    if (!Changed.count(F) || Removed.count(F))
+      continue;
+    if (!FunctionMap.count(F)) {
+      // A new function.
+      CallGraphNode *Node = getOrInsertFunction(F);
+      if (Root == ExternCallingNode && !F->hasLocalLinkage())
+        ExternCallingNode->addCalledFunction(CallSite(), Node);
+    }
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+        CallSite CS(Ins);
+        if (!CS.getInstruction())
+          continue;
+        FuncList Callees;
+        resolveCallSite(CS, Callees);
+        for (size_t i = 0; i < Callees.size(); ++i) {
+          if (!Removed.count(Callees[i]))
+            SiteToFuncs[Ins].push_back(Callees[i]);
+        }
+      }
+    }
+    Dirty.push_back(F);
+  }
+
+  // Invert the edges.
+  FuncToSites.clear();
   for (SiteToFuncsMapTy::iterator I = SiteToFuncs.begin();
        I != SiteToFuncs.end(); ++I) {
-    MakeUnique(I->second);
+    for (size_t i = 0; i < I->second.size(); ++i)
+      FuncToSites[I->second[i]].push_back(const_cast<Instruction *>(I->first));
+  }
+
+  // Update the CallGraphNodes. The nodes of the removed functions go last,
+  // after no other node refers to them.
+  for (size_t i = 0; i < Dirty.size(); ++i)
+    rebuildCallEdges(Dirty[i]);
+  bool RootRemoved = false;
+  for (FuncSet::const_iterator I = Removed.begin(); I != Removed.end(); ++I) {
+    FunctionMapTy::iterator J = FunctionMap.find(*I);
+    if (J == FunctionMap.end())
+      continue;
+    CallGraphNode *Node = J->second;
+    ExternCallingNode->removeAnyCallEdgeTo(Node);
+    Node->removeAllCalledFunctions();
+    FunctionMap.erase(J);
+    if (Root == Node)
+      RootRemoved = true;
+    delete Node;
+  }
+  // Without main, as in runOnModule, every function visible outside the
+  // module may be called from outside.
+  if (RootRemoved) {
+    Root = ExternCallingNode;
+    ExternCallingNode->removeAllCalledFunctions();
+    for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+      if (!F->hasLocalLinkage() && !Removed.count(F)) {
+        ExternCallingNode->addCalledFunction(CallSite(),
+                                             getOrInsertFunction(F));
+      }
+    }
+  }
+
+  finalizeCallGraph(M);
+  computeSCCs();
+  CHA.clear();
+  if (ReportTime) {
+    TimeRecord End = TimeRecord::getCurrentTime(false);
+    errs() << "Updated " << Changed.size() << " changed and "
+        << Removed.size() << " removed function(s) in "
+        << format("%.3f", End.getWallTime() - Start.getWallTime())
+        << " s\n";
+  }
+}
+
+namespace {
+// Layout of a cache file: the header, followed by NumEdges pairs of
+// (instruction ID of the call site, function ID of the callee), all as
+// native 32-bit integers. IDs are given by IDAssigner.
+struct CacheHeader {
+  char Magic[8];
+  uint32_t Version;
+  uint32_t NumEdges;
+  uint64_t Key;
+};
+}
+static const char CacheMagic[8] = "FPCGCAC";
+static const uint32_t CacheVersion = 2;
+
+namespace {
+// Collects the passes implementing alias analysis, PointerAnalysis or
+// AnalysisOptions, and whether they implement AnalysisOptions.
+struct AnalysisCollector: public PassRegistrationListener {
+  virtual void passEnumerate(const PassInfo *PI) {
+    const vector<const PassInfo *> &Groups = PI->getInterfacesImplemented();
+    bool Found = false, HasOptions = false;
+    for (size_t i = 0; i < Groups.size(); ++i) {
+      const void *Group = Groups[i]->getTypeInfo();
+      if (Group == &AliasAnalysis::ID || Group == &PointerAnalysis::ID)
+        Found = true;
+      if (Group == &AnalysisOptions::ID)
+        Found = HasOptions = true;
+    }
+    if (Found)
+      Passes.push_back(make_pair(PI, HasOptions));
+  }
+
+  vector<pair<const PassInfo *, bool> > Passes;
+};
+}
+
+// Hashes the module, the options of FPCallGraph, and the analyses in the
+// pass manager the edges may depend on. Every alias analysis counts, so
+// that a chain is identified by all of its members, and so does the output
+// of printOptions of every AnalysisOptions.
+uint64_t FPCallGraph::computeCacheKey(Module &M) {
+  AnalysisCollector Collector;
+  Collector.enumeratePasses();
+  vector<string> Analyses;
+  for (size_t i = 0; i < Collector.Passes.size(); ++i) {
+    const PassInfo *PI = Collector.Passes[i].first;
+    Pass *P = getResolver()->getAnalysisIfAvailable(PI->getTypeInfo(), true);
+    if (!P)
+      continue;
+    string Analysis;
+    raw_string_ostream OS(Analysis);
+    OS << PI->getPassArgument();
+    if (Collector.Passes[i].second) {
+      OS << " ";
+      ((AnalysisOptions *)P->getAdjustedAnalysisPointer(
+              &AnalysisOptions::ID))->printOptions(OS);
+    }
+    Analyses.push_back(OS.str());
+  }
+  // The registry enumerates passes in no particular order.
+  sort(Analyses.begin(), Analyses.end());
+
+  FNVHashStream Hasher;
+  Hasher << M;
+  for (size_t i = 0; i < Analyses.size(); ++i)
+    Hasher << "\nanalysis=" << Analyses[i];
+  Hasher << "\nuse-pa=" << (UsePA ? 1 : 0)
+      << "\nignore-arity=" << (IgnoreArity ? 1 : 0)
+      << "\ncha=" << (UseCHA ? 1 : 0) << "\n";
+  return Hasher.getHash();
+}
+
+string FPCallGraph::getCachePath(uint64_t Key) const {
+  char Name[32];
+  sprintf(Name, "%016llx.fpcg", (unsigned long long)Key);
+  return CacheDir + "/" + Name;
+}
+
+// Adds the edges in the cache file of <Key>, if any. Adds nothing unless the
+// whole file is valid.
+bool FPCallGraph::loadCache(uint64_t Key) {
+  string Path = getCachePath(Key);
+  OwningPtr<MemoryBuffer> Buffer;
+  if (MemoryBuffer::getFile(Path, Buffer, -1, false))
+    return false;
+
+  const char *Start = Buffer->getBufferStart();
+  size_t BufferSize = Buffer->getBufferSize();
+  if (BufferSize < sizeof(CacheHeader))
+    return false;
+  const CacheHeader *Header = reinterpret_cast<const CacheHeader *>(Start);
+  if (memcmp(Header->Magic, CacheMagic, sizeof(Header->Magic)) ||
+      Header->Version != CacheVersion || Header->Key != Key ||
+      BufferSize != sizeof(CacheHeader) +
+                    2 * sizeof(uint32_t) * (size_t)Header->NumEdges) {
+    errs() << Path << " is not a valid call graph cache\n";
+    return false;
+  }
+
+  IDAssigner &IDA = getAnalysis<IDAssigner>();
+  const uint32_t *Pairs = reinterpret_cast<const uint32_t *>(Header + 1);
+  vector<pair<Instruction *, Function *> > Edges;
+  Edges.reserve(Header->NumEdges);
+  for (uint32_t i = 0; i < Header->NumEdges; ++i) {
+    Instruction *Ins = IDA.getInstruction(Pairs[2 * i]);
+    Function *Callee = IDA.getFunction(Pairs[2 * i + 1]);
+    if (Ins == NULL || Callee == NULL || !CallSite(Ins).getInstruction()) {
+      errs() << Path << " does not match the module\n";
+      return false;
+    }
+    Edges.push_back(make_pair(Ins, Callee));
+  }
+  for (size_t i = 0; i < Edges.size(); ++i)
+    addCallEdge(CallSite(Edges[i].first), Edges[i].second);
+  return true;
+}
+
+// Writes the finalized edges to a temporary file and renames it, so that
+// concurrent runs never see a partial cache.
+void FPCallGraph::writeCache(Module &M, uint64_t Key) {
+  IDAssigner &IDA = getAnalysis<IDAssigner>();
+  vector<uint32_t> Pairs;
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+        ArrayRef<Function *> Callees = getCalledFunctions(Ins);
+        for (size_t i = 0; i < Callees.size(); ++i) {
+          Pairs.push_back(IDA.getInstructionID(Ins));
+          Pairs.push_back(IDA.getFunctionID(Callees[i]));
+        }
+      }
+    }
+  }
+
+  string Path = getCachePath(Key);
+  string TempPath = Path + ".tmp" + utostr(getpid());
+  {
+    string ErrorInfo;
+    raw_fd_ostream Out(TempPath.c_str(), ErrorInfo,
+                       raw_fd_ostream::F_Binary);
+    if (!ErrorInfo.empty()) {
+      errs() << ErrorInfo << "\n";
+      return;
+    }
+    CacheHeader Header;
+    memcpy(Header.Magic, CacheMagic, sizeof(Header.Magic));
+    Header.Version = CacheVersion;
+    Header.NumEdges = Pairs.size() / 2;
+    Header.Key = Key;
+    Out.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+    if (!Pairs.empty()) {
+      Out.write(reinterpret_cast<const char *>(&Pairs[0]),
+                Pairs.size() * sizeof(Pairs[0]));
+    }
+  }
+  if (error_code EC = sys::fs::rename(TempPath, Path)) {
+    errs() << "Cannot write " << Path << ": " << EC.message() << "\n";
+    bool Existed;
+    sys::fs::remove(TempPath, Existed);
   }
-  for (FuncToSitesMapTy::iterator I = FuncToSites.begin();
-       I != FuncToSites.end(); ++I) {
-    MakeUnique(I->second);
+}
+
+void FPCallGraph::finalizeCallGraph(Module &M) {
+  SiteIDs.clear();
+  FuncIDs.clear();
+  CalleeOffsets.clear();
+  SiteCallees.clear();
+  CallSiteOffsets.clear();
+  FuncCallSites.clear();
+
+  // Number the call sites and the called functions in the module order, and
+  // move their unique callees and call sites into the CSR arrays. Only
+  // entries with at least one element get an ID, so that no range is empty.
+  CalleeOffsets.push_back(0);
+  CallSiteOffsets.push_back(0);
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    FuncToSitesMapTy::iterator J = FuncToSites.find(F);
+    if (J != FuncToSites.end()) {
+      MakeUnique(J->second);
+      FuncIDs[F] = CallSiteOffsets.size() - 1;
+      FuncCallSites.insert(FuncCallSites.end(), J->second.begin(),
+                           J->second.end());
+      CallSiteOffsets.push_back(FuncCallSites.size());
+    }
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins) {
+        SiteToFuncsMapTy::iterator I = SiteToFuncs.find(Ins);
+        if (I == SiteToFuncs.end())
+          continue;
+        MakeUnique(I->second);
+        SiteIDs[Ins] = CalleeOffsets.size() - 1;
+        SiteCallees.insert(SiteCallees.end(), I->second.begin(),
+                           I->second.end());
+        CalleeOffsets.push_back(SiteCallees.size());
+      }
+    }
   }
+
+  // The maps are only for building.
+  SiteToFuncsMapTy().swap(SiteToFuncs);
+  FuncToSitesMapTy().swap(FuncToSites);
+}
+
+void FPCallGraph::computeSCCs() {
+  SCCIDs.clear();
+  SCCOffsets.clear();
+  SCCFuncs.clear();
+  SCCHasLoop.clear();
+
+  // scc_iterator visits the SCCs in reverse topological order.
+  CallGraph *CG = this;
+  SCCOffsets.push_back(0);
+  for (scc_iterator<CallGraph *> SI = scc_begin(CG), E = scc_end(CG);
+       SI != E; ++SI) {
+    unsigned ID = SCCHasLoop.size();
+    for (size_t i = 0; i < (*SI).size(); ++i) {
+      if (Function *F = (*SI)[i]->getFunction()) {
+        SCCIDs[F] = ID;
+        SCCFuncs.push_back(F);
+      }
+    }
+    SCCOffsets.push_back(SCCFuncs.size());
+    SCCHasLoop.push_back(SI.hasLoop());
+  }
+}
+
+unsigned FPCallGraph::getSCCID(const Function *F) const {
+  DenseMap<const Function *, unsigned>::const_iterator I = SCCIDs.find(F);
+  if (I == SCCIDs.end())
+    return ~0U;
+  return I->second;
+}
+
+ArrayRef<Function *> FPCallGraph::getSCC(unsigned ID) const {
+  assert(ID < getNumSCCs());
+  unsigned Begin = SCCOffsets[ID], End = SCCOffsets[ID + 1];
+  if (Begin == End)
+    return ArrayRef<Function *>();
+  return ArrayRef<Function *>(&SCCFuncs[Begin], End - Begin);
 }
 
 void FPCallGraph::print(llvm::raw_ostream &O, const Module *M) const {
@@ -211,10 +979,9 @@ void FPCallGraph::print(llvm::raw_ostream &O, const Module *M) const {
       for (BasicBlock::const_iterator Ins = BB->begin();
            Ins != BB->end(); ++Ins) {
         if (is_call(Ins)) {
-          const FuncList &CalledFunctions = getCalledFunctions(Ins);
-          for (FuncList::const_iterator I = CalledFunctions.begin();
-               I != CalledFunctions.end(); ++I)
-            AllCallees.push_back(*I);
+          ArrayRef<Function *> CalledFunctions = getCalledFunctions(Ins);
+          AllCallees.insert(AllCallees.end(), CalledFunctions.begin(),
+                            CalledFunctions.end());
         }
       }
     }
@@ -228,11 +995,10 @@ void FPCallGraph::print(llvm::raw_ostream &O, const Module *M) const {
   O << "Callee - Caller:\n";
   for (Module::const_iterator F = M->begin(); F != M->end(); ++F) {
     // All calling functions to <F>.
-    const InstList &CallSites = getCallSites(F);
+    ArrayRef<Instruction *> Sites = getCallSites(F);
     FuncList AllCallers;
-    for (InstList::const_iterator I = CallSites.begin();
-         I != CallSites.end(); ++I)
-      AllCallers.push_back((*I)->getParent()->getParent());
+    for (size_t i = 0; i < Sites.size(); ++i)
+      AllCallers.push_back(Sites[i]->getParent()->getParent());
     MakeUnique(AllCallers);
     if (!AllCallers.empty()) {
       O << "\t" << F->getName() << " is called by:\n";
@@ -29,7 +29,7 @@ bool IdentifyThreadFuncs::runOnModule(Module &M) {
               ThreadFuncs.insert(cast<Function>(ThreadFunc));
             } else {
               FPCallGraph &CG = getAnalysis<FPCallGraph>();
-              FuncList Callees = CG.getCalledFunctions(I);
+              ArrayRef<Function *> Callees = CG.getCalledFunctions(I);
               for (size_t i = 0; i < Callees.size(); ++i) {
                 if (Callees[i]->getName() != "pthread_create")
                   ThreadFuncs.insert(Callees[i]);
@@ -21,11 +21,25 @@ MicroBasicBlock::iterator MicroBasicBlock::getFirstNonPHI() {
 }
 
 bool MicroBasicBlockBuilder::runOnModule(Module &M) {
-  parent_mbb.clear();
-  mbbmap.clear();
+  mbbs.clear();
+  bb_ids.clear();
+  bb_offsets.clear();
 
+  // Count the MBBs first, so that <mbbs> never reallocates. 
+  unsigned n_mbbs = 0, n_bbs = 0;
   forallbb(M, bb) {
-    MBBListType *mbblist = new MBBListType;
+    for (BasicBlock::iterator ii = bb->begin(); ii != bb->end(); ++ii) {
+      if (bb->getTerminator() == ii || is_non_intrinsic_call(ii))
+        ++n_mbbs;
+    }
+    ++n_bbs;
+  }
+  mbbs.reserve(n_mbbs);
+  bb_offsets.reserve(n_bbs + 1);
+
+  bb_offsets.push_back(0);
+  forallbb(M, bb) {
+    bb_ids[bb] = bb_offsets.size() - 1;
     for (BasicBlock::iterator ib = bb->begin(); ib != bb->end(); ) {
       BasicBlock::iterator ie = ib;
       while (bb->getTerminator() != ie && !is_non_intrinsic_call(ie))
@@ -34,27 +48,53 @@ bool MicroBasicBlockBuilder::runOnModule(Module &M) {
       assert(ie != bb->end());
       ++ie;
       // <ie> points to the successor of the MBB. 
-      MicroBasicBlock *mbb = new MicroBasicBlock(bb, ib, ie);
-      mbblist->push_back(mbb);
-      // Reverse mapping from Instruction to its containing MBB. 
-      for (BasicBlock::iterator ii = ib; ii != ie; ++ii)
-        parent_mbb[ii] = mbb;
+      mbbs.push_back(MicroBasicBlock(bb, ib, ie));
       ib = ie;
     }
-    mbbmap[bb] = mbblist;
+    bb_offsets.push_back(mbbs.size());
   }
+  assert(mbbs.size() == n_mbbs);
 
   return false;
 }
 
 mbb_iterator MicroBasicBlockBuilder::begin(BasicBlock *bb) {
-  assert(exist(bb, mbbmap) && "not a basic block");
-  return mbbmap[bb]->begin();
+  assert(bb_ids.count(bb) && "not a basic block");
+  return &mbbs[0] + bb_offsets[bb_ids.lookup(bb)];
 }
 
 mbb_iterator MicroBasicBlockBuilder::end(BasicBlock *bb) {
-  assert(exist(bb, mbbmap) && "not a basic block");
-  return mbbmap[bb]->end();
+  assert(bb_ids.count(bb) && "not a basic block");
+  return &mbbs[0] + bb_offsets[bb_ids.lookup(bb) + 1];
+}
+
+/**
+ * Walks back to the first instruction of the MBB, and finds the MBB
+ * starting there among the few MBBs of the basic block. MBBs are short, 
+ * so this is cheap, and saves a map entry per instruction. 
+ */
+mbb_iterator MicroBasicBlockBuilder::parent(const Instruction *ins) {
+  BasicBlock *bb = const_cast<BasicBlock *>(ins->getParent());
+  DenseMap<const BasicBlock *, unsigned>::iterator it = bb_ids.find(bb);
+  if (it == bb_ids.end())
+    return NULL;
+
+  BasicBlock::iterator first = const_cast<Instruction *>(ins);
+  while (first != bb->begin()) {
+    BasicBlock::iterator prev = first;
+    --prev;
+    if (is_non_intrinsic_call(prev))
+      break;
+    first = prev;
+  }
+
+  for (unsigned i = bb_offsets[it->second]; i < bb_offsets[it->second + 1];
+       ++i) {
+    if (mbbs[i].begin() == first)
+      return &mbbs[i];
+  }
+  assert_unreachable();
+  return NULL;
 }
 
 char MicroBasicBlockBuilder::ID = 0;
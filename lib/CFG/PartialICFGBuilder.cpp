@@ -77,7 +77,7 @@ bool PartialICFGBuilder::runOnModule(Module &M) {
       // The main function returns to nowhere. 
       if (is_ret(last) && bb->getParent() != main) {
         FPCallGraph &CG = getAnalysis<FPCallGraph>();
-        InstList call_sites = CG.getCallSites(bb->getParent());
+        ArrayRef<Instruction *> call_sites = CG.getCallSites(bb->getParent());
         unsigned n_reachable_call_sites = 0;
         Instruction *the_call_site = NULL;
         for (size_t j = 0; j < call_sites.size(); ++j) {
@@ -132,7 +132,7 @@ Function *PartialICFGBuilder::trace_into(Instruction *ins) {
   if (is_pthread_create(ins))
     return NULL;
   FPCallGraph &CG = getAnalysis<FPCallGraph>();
-  FuncList callees = CG.getCalledFunctions(ins);
+  ArrayRef<Function *> callees = CG.getCalledFunctions(ins);
   if (callees.size() != 1)
     return NULL;
   Function *callee = callees[0];
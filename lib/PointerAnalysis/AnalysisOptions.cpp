@@ -0,0 +1,9 @@
+#include "llvm/Pass.h"
+using namespace llvm;
+
+#include "rcs/AnalysisOptions.h"
+using namespace rcs;
+
+char AnalysisOptions::ID = 0;
+
+static RegisterAnalysisGroup<AnalysisOptions> A("Analysis Options");
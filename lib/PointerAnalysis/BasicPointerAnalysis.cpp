@@ -25,17 +25,17 @@ struct BasicPointerAnalysis: public ModulePass, public PointerAnalysis {
 
   virtual void getAllPointers(ValueList &Pointers);
   virtual bool getPointees(const Value *Pointer, ValueList &Pointees);
+  virtual bool getPointeeRange(const Value *Pointer,
+                               ArrayRef<Value *> &Pointees);
+  virtual bool isThreadSafe() { return true; }
 
   // A very important function. Otherwise getAnalysis<PointerAnalysis> would
   // not be able to return BasicPointerAnalysis. 
   virtual void *getAdjustedAnalysisPointer(AnalysisID PI);
   
  private:
-  bool isMallocCall(Value *V) const;
-  bool isMalloc(Function *F) const;
   bool shouldFilterOut(Value *V) const;
 
-  vector<string> MallocNames;
   // Leader[V] is the leader of the equivalence class <V> belongs to. 
   // We could use llvm::EquivalenceClasses here. 
   ConstValueMapping Leader;
@@ -59,17 +59,7 @@ void BasicPointerAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<AliasAnalysis>();
 }
 
-BasicPointerAnalysis::BasicPointerAnalysis(): ModulePass(ID) {
-  // Initialize the list of memory allocatores.
-  MallocNames.push_back("malloc");
-  MallocNames.push_back("calloc");
-  MallocNames.push_back("valloc");
-  MallocNames.push_back("realloc");
-  MallocNames.push_back("memalign");
-  MallocNames.push_back("_Znwm");
-  MallocNames.push_back("_Znaj");
-  MallocNames.push_back("_Znam");
-}
+BasicPointerAnalysis::BasicPointerAnalysis(): ModulePass(ID) {}
 
 bool BasicPointerAnalysis::shouldFilterOut(Value *V) const {
   if (Argument *Arg = dyn_cast<Argument>(V)) {
@@ -124,13 +114,22 @@ void BasicPointerAnalysis::getAllPointers(ValueList &Pointers) {
 
 bool BasicPointerAnalysis::getPointees(const Value *Pointer,
                                        ValueList &Pointees) {
+  ArrayRef<Value *> Range;
+  if (!getPointeeRange(Pointer, Range))
+    return false;
+  Pointees.assign(Range.begin(), Range.end());
+  return true;
+}
+
+bool BasicPointerAnalysis::getPointeeRange(const Value *Pointer,
+                                           ArrayRef<Value *> &Pointees) {
   assert(Pointer->getType()->isPointerTy() && "<Pointer> is not a pointer");
 
   if (!Leader.count(Pointer))
     return false;
   const Value *TheLeader = Leader.lookup(Pointer);
 
-  Pointees.clear();
+  Pointees = ArrayRef<Value *>();
   DenseMap<const Value *, ValueList>::const_iterator I =
       Allocators.find(TheLeader);
   if (I != Allocators.end())
@@ -139,26 +138,6 @@ bool BasicPointerAnalysis::getPointees(const Value *Pointer,
   return true;
 }
 
-bool BasicPointerAnalysis::isMallocCall(Value *V) const {
-  Instruction *I = dyn_cast<Instruction>(V);
-  if (I == NULL)
-    return false;
-
-  CallSite CS(I);
-  if (CS.getInstruction() == NULL)
-    return false;
-
-  Function *Callee = CS.getCalledFunction();
-  return Callee && isMalloc(Callee);
-}
-
-bool BasicPointerAnalysis::isMalloc(Function *F) const {
-  vector<string>::const_iterator Pos = find(MallocNames.begin(),
-                                            MallocNames.end(),
-                                            F->getName());
-  return Pos != MallocNames.end();
-}
-
 void *BasicPointerAnalysis::getAdjustedAnalysisPointer(AnalysisID PI) {
   if (PI == &PointerAnalysis::ID)
     return (PointerAnalysis *)this;
@@ -57,8 +57,8 @@ void PointToDrawer::printToDot(raw_ostream &O) {
     assert(PointerVid != IDAssigner::InvalidID);
     PointerVids.insert(PointerVid);
 
-    ValueList Pointees;
-    PA.getPointees(Pointer, Pointees);
+    ArrayRef<Value *> Pointees;
+    PA.getPointeeRange(Pointer, Pointees);
 
     for (size_t j = 0; j < Pointees.size(); ++j) {
       Value *Pointee = Pointees[j];
@@ -9,9 +9,12 @@
 // PointerAnalysis is a AnalysisGroup. The default instance of this group
 // is BasicPointerAnalysis. 
 
+#include <algorithm>
 #include <set>
 using namespace std;
 
+#include "llvm/Instruction.h"
+#include "llvm/Support/CallSite.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
@@ -23,6 +26,67 @@ char PointerAnalysis::ID = 0;
 
 static RegisterAnalysisGroup<PointerAnalysis> A("Pointer Analysis");
 
+PointerAnalysis::PointerAnalysis() {
+  // Initialize the list of memory allocatores.
+  MallocNames.push_back("malloc");
+  MallocNames.push_back("calloc");
+  MallocNames.push_back("valloc");
+  MallocNames.push_back("realloc");
+  MallocNames.push_back("memalign");
+  MallocNames.push_back("_Znwm");
+  MallocNames.push_back("_Znaj");
+  MallocNames.push_back("_Znam");
+}
+
+bool PointerAnalysis::isMallocCall(const Value *V) const {
+  const Instruction *I = dyn_cast<Instruction>(V);
+  if (I == NULL)
+    return false;
+
+  ImmutableCallSite CS(I);
+  if (CS.getInstruction() == NULL)
+    return false;
+
+  const Function *Callee = CS.getCalledFunction();
+  return Callee && isMalloc(Callee);
+}
+
+bool PointerAnalysis::isMalloc(const Function *F) const {
+  vector<string>::const_iterator Pos = find(MallocNames.begin(),
+                                            MallocNames.end(),
+                                            F->getName());
+  return Pos != MallocNames.end();
+}
+
+bool PointerAnalysis::getPointeeRange(const Value *Pointer,
+                                      ArrayRef<Value *> &Pointees) {
+  if (!getPointees(Pointer, PointeeBuffer))
+    return false;
+  Pointees = PointeeBuffer;
+  return true;
+}
+
+void PointerAnalysis::exportPointsTo(IDAssigner &IDA,
+                                     vector<unsigned> &Offsets,
+                                     vector<unsigned> &PointeeIDs) {
+  Offsets.clear();
+  Offsets.reserve(IDA.getNumValues() + 1);
+  PointeeIDs.clear();
+  Offsets.push_back(0);
+  for (unsigned i = 0; i < IDA.getNumValues(); ++i) {
+    Value *V = IDA.getValue(i);
+    ArrayRef<Value *> Pointees;
+    if (V->getType()->isPointerTy() && getPointeeRange(V, Pointees)) {
+      for (size_t j = 0; j < Pointees.size(); ++j) {
+        unsigned PointeeID = IDA.getValueID(Pointees[j]);
+        if (PointeeID != IDAssigner::InvalidID)
+          PointeeIDs.push_back(PointeeID);
+      }
+    }
+    Offsets.push_back(PointeeIDs.size());
+  }
+}
+
 void PointerAnalysis::printStats(raw_ostream &O) {
   ValueList Pointers;
   getAllPointers(Pointers);
@@ -30,9 +94,9 @@ void PointerAnalysis::printStats(raw_ostream &O) {
 
   unsigned NumPointTos = 0;
   for (size_t i = 0; i < Pointers.size(); ++i) {
-    ValueList Pointees;
-    getPointees(Pointers[i], Pointees);
-    NumPointTos += Pointees.size();
+    ArrayRef<Value *> Pointees;
+    if (getPointeeRange(Pointers[i], Pointees))
+      NumPointTos += Pointees.size();
   }
   O << "# of point-to relations = " << NumPointTos << "\n";
 }
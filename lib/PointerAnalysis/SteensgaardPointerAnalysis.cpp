@@ -0,0 +1,591 @@
+// A unification-based (Steensgaard-style) implementation of PointerAnalysis.
+//
+// Every value has a node, and every node points to at most one node, its
+// pointee. An assignment x = y unifies the pointees of x and y instead of
+// adding an edge, so the whole program is processed in a single pass over
+// the IR, and the run time is almost linear in its size. The answer has the
+// same shape as BasicPointerAnalysis's: all pointers in an equivalence class
+// point to the allocators of the class.
+//
+// Memory that external code may reach is merged into one class, the unknown
+// class, which points to itself. Pointers to it have no answer.
+
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Constants.h"
+#include "llvm/GlobalVariable.h"
+#include "llvm/InlineAsm.h"
+#include "llvm/Instructions.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+
+#include "rcs/IDAssigner.h"
+#include "rcs/PointerAnalysis.h"
+using namespace rcs;
+
+namespace rcs {
+struct SteensgaardPointerAnalysis: public ModulePass, public PointerAnalysis {
+  static char ID;
+
+  SteensgaardPointerAnalysis(): ModulePass(ID) {}
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+  virtual bool runOnModule(Module &M);
+  virtual void releaseMemory();
+
+  virtual void getAllPointers(ValueList &Pointers);
+  virtual bool getPointees(const Value *Pointer, ValueList &Pointees);
+  virtual bool getPointeeRange(const Value *Pointer,
+                               ArrayRef<Value *> &Pointees);
+  // runOnModule leaves no paths to compress.
+  virtual bool isThreadSafe() { return true; }
+
+  virtual void *getAdjustedAnalysisPointer(AnalysisID PI);
+
+ private:
+  static const unsigned None = ~0U;
+
+  bool shouldFilterOut(Value *V) const;
+  unsigned createNode();
+  unsigned find(unsigned N);
+  void join(unsigned A, unsigned B);
+  unsigned getPointee(unsigned N);
+  unsigned getNode(Value *V);
+  unsigned getObject(Value *V);
+  unsigned getReturn(Function *F);
+  unsigned getSignature(unsigned Object, unsigned NumArgs);
+  // The pointee of <V> is unknown.
+  void addUnknown(Value *V);
+  // Callers of the functions in the class of <Object> pass and get back
+  // unknown pointers, from the <First>-th entry of the signature on.
+  void addUnknownSignature(unsigned Object, unsigned First);
+  void addExternalCall(CallSite CS, Function *F);
+  // x = y
+  void addAssign(Value *X, Value *Y);
+  // x = *y
+  void addLoad(Value *X, Value *Y);
+  // *x = y
+  void addStore(Value *X, Value *Y);
+  void addInitializer(unsigned Object, Constant *C);
+  void visitInstruction(Instruction *I);
+  void visitCallSite(CallSite CS);
+
+  // The unknown class.
+  unsigned Unknown;
+  // Union-find. Pointee[N] and Signature[N] are only meaningful for
+  // representatives, and Pointee[N] may be a non-representative node.
+  vector<unsigned> Parent;
+  vector<unsigned> Rank;
+  vector<unsigned> Pointee;
+  vector<unsigned> Signature;
+  // Signatures[S][0] is the return node, and Signatures[S][i + 1] is the
+  // node of the i-th argument. Function objects have one, so that calls
+  // through a pointer unify their arguments with the callee's.
+  vector<vector<unsigned> > Signatures;
+  vector<pair<unsigned, unsigned> > PendingJoins;
+  DenseMap<const Value *, unsigned> ValueNodes;
+  DenseMap<const Value *, unsigned> ObjectNodes;
+  DenseMap<const Function *, unsigned> ReturnNodes;
+  // Allocators[R] is the set of all allocators whose objects are in the
+  // class represented by R.
+  DenseMap<unsigned, ValueList> Allocators;
+};
+}
+
+char SteensgaardPointerAnalysis::ID = 0;
+const unsigned SteensgaardPointerAnalysis::None;
+
+static RegisterPass<SteensgaardPointerAnalysis> X(
+    "steens-pa",
+    "Steensgaard's Pointer Analysis",
+    false, // Is CFG Only?
+    true); // Is Analysis?
+static RegisterAnalysisGroup<PointerAnalysis> Y(X);
+
+void SteensgaardPointerAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<IDAssigner>();
+}
+
+bool SteensgaardPointerAnalysis::shouldFilterOut(Value *V) const {
+  if (Argument *Arg = dyn_cast<Argument>(V)) {
+    if (Arg->getParent()->isDeclaration())
+      return true;
+  }
+  return false;
+}
+
+unsigned SteensgaardPointerAnalysis::createNode() {
+  unsigned N = Parent.size();
+  Parent.push_back(N);
+  Rank.push_back(0);
+  Pointee.push_back(None);
+  Signature.push_back(None);
+  return N;
+}
+
+unsigned SteensgaardPointerAnalysis::find(unsigned N) {
+  unsigned Root = N;
+  while (Parent[Root] != Root)
+    Root = Parent[Root];
+  while (Parent[N] != Root) {
+    unsigned Next = Parent[N];
+    Parent[N] = Root;
+    N = Next;
+  }
+  return Root;
+}
+
+// Unifies the classes of <A> and <B>, and then their pointees and
+// signatures. Uses an explicit list instead of recursion, because long
+// chains of pointers are common.
+void SteensgaardPointerAnalysis::join(unsigned A, unsigned B) {
+  PendingJoins.push_back(make_pair(A, B));
+  while (!PendingJoins.empty()) {
+    unsigned R = find(PendingJoins.back().first);
+    unsigned O = find(PendingJoins.back().second);
+    PendingJoins.pop_back();
+    if (R == O)
+      continue;
+
+    if (Rank[R] < Rank[O])
+      swap(R, O);
+    else if (Rank[R] == Rank[O])
+      ++Rank[R];
+    Parent[O] = R;
+
+    if (Pointee[O] != None) {
+      if (Pointee[R] == None)
+        Pointee[R] = Pointee[O];
+      else
+        PendingJoins.push_back(make_pair(Pointee[R], Pointee[O]));
+    }
+    if (Signature[O] != None) {
+      if (Signature[R] == None) {
+        Signature[R] = Signature[O];
+      } else {
+        vector<unsigned> &SR = Signatures[Signature[R]];
+        const vector<unsigned> &SO = Signatures[Signature[O]];
+        for (size_t i = 0; i < SO.size(); ++i) {
+          if (i < SR.size())
+            PendingJoins.push_back(make_pair(SR[i], SO[i]));
+          else
+            SR.push_back(SO[i]);
+        }
+      }
+    }
+  }
+}
+
+// Returns the pointee of <N>, creating one if <N> points to nothing yet.
+unsigned SteensgaardPointerAnalysis::getPointee(unsigned N) {
+  N = find(N);
+  if (Pointee[N] == None) {
+    unsigned P = createNode();
+    Pointee[N] = P;
+  }
+  return Pointee[N];
+}
+
+unsigned SteensgaardPointerAnalysis::getNode(Value *V) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+    if (CE->isCast() || CE->getOpcode() == Instruction::GetElementPtr)
+      return getNode(CE->getOperand(0));
+  }
+  // Other constants that are not globals, such as null and integers, do not
+  // point to anything. Giving each use a fresh node keeps them from merging
+  // unrelated classes.
+  if (isa<Constant>(V) && !isa<GlobalValue>(V))
+    return createNode();
+
+  DenseMap<const Value *, unsigned>::iterator I = ValueNodes.find(V);
+  if (I != ValueNodes.end())
+    return I->second;
+  unsigned N = createNode();
+  ValueNodes[V] = N;
+  return N;
+}
+
+unsigned SteensgaardPointerAnalysis::getObject(Value *V) {
+  DenseMap<const Value *, unsigned>::iterator I = ObjectNodes.find(V);
+  if (I != ObjectNodes.end())
+    return I->second;
+  unsigned N = createNode();
+  ObjectNodes[V] = N;
+  join(getPointee(getNode(V)), N);
+  return N;
+}
+
+unsigned SteensgaardPointerAnalysis::getReturn(Function *F) {
+  DenseMap<const Function *, unsigned>::iterator I = ReturnNodes.find(F);
+  if (I != ReturnNodes.end())
+    return I->second;
+  unsigned N = createNode();
+  ReturnNodes[F] = N;
+  return N;
+}
+
+// Returns the signature of the class of <Object>, making sure it has room
+// for <NumArgs> arguments.
+unsigned SteensgaardPointerAnalysis::getSignature(unsigned Object,
+                                                  unsigned NumArgs) {
+  Object = find(Object);
+  if (Signature[Object] == None) {
+    Signature[Object] = Signatures.size();
+    Signatures.push_back(vector<unsigned>(1, createNode()));
+  }
+  unsigned S = Signature[Object];
+  while (Signatures[S].size() < NumArgs + 1) {
+    unsigned N = createNode();
+    Signatures[S].push_back(N);
+  }
+  return S;
+}
+
+void SteensgaardPointerAnalysis::addUnknown(Value *V) {
+  join(getPointee(getNode(V)), Unknown);
+}
+
+void SteensgaardPointerAnalysis::addUnknownSignature(unsigned Object,
+                                                    unsigned First) {
+  // join may move the class to another signature, or grow it.
+  for (unsigned i = First;
+       i < Signatures[getSignature(Object, 0)].size(); ++i) {
+    unsigned S = getSignature(Object, 0);
+    join(getPointee(Signatures[S][i]), Unknown);
+  }
+}
+
+void SteensgaardPointerAnalysis::addAssign(Value *X, Value *Y) {
+  join(getPointee(getNode(X)), getPointee(getNode(Y)));
+}
+
+void SteensgaardPointerAnalysis::addLoad(Value *X, Value *Y) {
+  join(getPointee(getNode(X)), getPointee(getPointee(getNode(Y))));
+}
+
+void SteensgaardPointerAnalysis::addStore(Value *X, Value *Y) {
+  join(getPointee(getPointee(getNode(X))), getPointee(getNode(Y)));
+}
+
+// The memory of <Object> holds everything its initializer <C> points to.
+// Aggregates are not split into fields.
+void SteensgaardPointerAnalysis::addInitializer(unsigned Object, Constant *C) {
+  if (C->getType()->isPointerTy()) {
+    if (!isa<ConstantPointerNull>(C) && !isa<UndefValue>(C))
+      join(getPointee(Object), getPointee(getNode(C)));
+    return;
+  }
+  if (isa<ConstantArray>(C) || isa<ConstantStruct>(C) ||
+      isa<ConstantVector>(C)) {
+    for (unsigned i = 0; i < C->getNumOperands(); ++i)
+      addInitializer(Object, cast<Constant>(C->getOperand(i)));
+  }
+}
+
+bool SteensgaardPointerAnalysis::runOnModule(Module &M) {
+  Unknown = createNode();
+  join(getPointee(Unknown), Unknown);
+
+  // Objects of globals and functions, and the signatures of functions.
+  for (Module::global_iterator GI = M.global_begin(); GI != M.global_end();
+       ++GI) {
+    getObject(GI);
+  }
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    unsigned S = getSignature(getObject(F), F->arg_size());
+    join(Signatures[S][0], getReturn(F));
+    unsigned i = 1;
+    for (Function::arg_iterator AI = F->arg_begin(); AI != F->arg_end();
+         ++AI, ++i) {
+      join(Signatures[S][i], getNode(AI));
+    }
+  }
+
+  for (Module::global_iterator GI = M.global_begin(); GI != M.global_end();
+       ++GI) {
+    if (GI->hasInitializer())
+      addInitializer(getObject(GI), GI->getInitializer());
+  }
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+      for (BasicBlock::iterator Ins = BB->begin(); Ins != BB->end(); ++Ins)
+        visitInstruction(Ins);
+    }
+  }
+
+  // Calls through pointers may reach external functions, and variadic
+  // arguments are only read through va_arg, so both pass unknown pointers.
+  // Functions that external code gets hold of are called with unknown
+  // pointers as well. Joins may grow the signature of the unknown class,
+  // so that one goes on until nothing changes.
+  for (Module::iterator F = M.begin(); F != M.end(); ++F) {
+    if (F->isDeclaration()) {
+      if (!F->isIntrinsic() && F->hasAddressTaken())
+        addUnknownSignature(getObject(F), 0);
+    } else if (F->isVarArg()) {
+      addUnknownSignature(getObject(F), F->arg_size() + 1);
+    }
+  }
+  for (;;) {
+    unsigned R = find(Unknown);
+    if (Signature[R] == None)
+      break;
+    size_t Size = Signatures[Signature[R]].size();
+    addUnknownSignature(R, 0);
+    R = find(Unknown);
+    if (Signatures[Signature[R]].size() == Size)
+      break;
+  }
+
+  for (DenseMap<const Value *, unsigned>::iterator I = ObjectNodes.begin();
+       I != ObjectNodes.end(); ++I) {
+    Allocators[find(I->second)].push_back(const_cast<Value *>(I->first));
+  }
+  dbgs() << "# of equivalence classes = " << Allocators.size() << "\n";
+
+  // Point every node directly to its root, so that queries never compress
+  // paths, and clients may query from multiple threads.
+  for (unsigned N = 0; N < Parent.size(); ++N)
+    Parent[N] = find(N);
+
+  vector<pair<unsigned, unsigned> >().swap(PendingJoins);
+  return false;
+}
+
+void SteensgaardPointerAnalysis::visitInstruction(Instruction *I) {
+  switch (I->getOpcode()) {
+    case Instruction::Alloca:
+      getObject(I);
+      break;
+    case Instruction::Load:
+      addLoad(I, I->getOperand(0));
+      break;
+    case Instruction::Store:
+      addStore(I->getOperand(1), I->getOperand(0));
+      break;
+    case Instruction::Ret:
+      if (I->getNumOperands() > 0) {
+        join(getPointee(getReturn(I->getParent()->getParent())),
+             getPointee(getNode(I->getOperand(0))));
+      }
+      break;
+    case Instruction::Call:
+    case Instruction::Invoke:
+      visitCallSite(CallSite(I));
+      break;
+    case Instruction::AtomicRMW:
+    case Instruction::AtomicCmpXchg:
+      // Both load the old value and store a new one. The new value is the
+      // last operand.
+      addLoad(I, I->getOperand(0));
+      addStore(I->getOperand(0), I->getOperand(I->getNumOperands() - 1));
+      break;
+    case Instruction::VAArg:
+      addUnknown(I);
+      break;
+    case Instruction::GetElementPtr:
+    case Instruction::ExtractValue:
+    case Instruction::ExtractElement:
+      addAssign(I, I->getOperand(0));
+      break;
+    case Instruction::InsertValue:
+    case Instruction::InsertElement:
+    case Instruction::ShuffleVector:
+      addAssign(I, I->getOperand(0));
+      addAssign(I, I->getOperand(1));
+      break;
+    case Instruction::PHI:
+      for (unsigned i = 0; i < I->getNumOperands(); ++i)
+        addAssign(I, I->getOperand(i));
+      break;
+    case Instruction::Select:
+      addAssign(I, I->getOperand(1));
+      addAssign(I, I->getOperand(2));
+      break;
+    default:
+      if (isa<CastInst>(I))
+        addAssign(I, I->getOperand(0));
+      break;
+  }
+}
+
+void SteensgaardPointerAnalysis::visitCallSite(CallSite CS) {
+  Instruction *I = CS.getInstruction();
+  if (isMallocCall(I)) {
+    getObject(I);
+    return;
+  }
+  // *dst = *src
+  if (MemTransferInst *MTI = dyn_cast<MemTransferInst>(I)) {
+    join(getPointee(getPointee(getNode(MTI->getRawDest()))),
+         getPointee(getPointee(getNode(MTI->getRawSource()))));
+    return;
+  }
+  if (isa<IntrinsicInst>(I))
+    return;
+  if (isa<InlineAsm>(CS.getCalledValue())) {
+    addUnknown(I);
+    for (unsigned i = 0; i < CS.arg_size(); ++i)
+      addUnknown(CS.getArgument(i));
+    return;
+  }
+  if (Function *F = CS.getCalledFunction()) {
+    if (F->isDeclaration()) {
+      addExternalCall(CS, F);
+      return;
+    }
+  }
+
+  unsigned Callee;
+  if (Function *F = CS.getCalledFunction())
+    Callee = getObject(F);
+  else
+    Callee = getPointee(getNode(CS.getCalledValue()));
+  unsigned S = getSignature(Callee, CS.arg_size());
+  // getSignature may have grown Signatures.
+  join(getPointee(Signatures[S][0]), getPointee(getNode(I)));
+  for (unsigned i = 0; i < CS.arg_size(); ++i) {
+    unsigned Arg = getPointee(getNode(CS.getArgument(i)));
+    S = getSignature(Callee, CS.arg_size());
+    join(getPointee(Signatures[S][i + 1]), Arg);
+  }
+}
+
+// Models a direct call to the external function <F>, like
+// Andersens::AddConstraintsForExternalCall does.
+void SteensgaardPointerAnalysis::addExternalCall(CallSite CS, Function *F) {
+  Instruction *I = CS.getInstruction();
+  StringRef Name = F->getName();
+
+  // These functions do not make anything point to anything.
+  static const char *const NoEffect[] = {
+    "atoi", "atof", "atol", "atoll", "remove", "unlink", "rename", "memcmp",
+    "strcmp", "strncmp", "strlen", "execl", "execlp", "execle", "execv",
+    "execvp", "chmod", "puts", "write", "open", "create", "truncate", "chdir",
+    "mkdir", "rmdir", "read", "pipe", "wait", "time", "stat", "fstat",
+    "lstat", "strtod", "strtof", "strtold", "fopen", "fdopen", "fflush",
+    "feof", "fileno", "clearerr", "rewind", "ftell", "ferror", "fgetc",
+    "_IO_getc", "fwrite", "fread", "fgets", "ungetc", "fputc", "fputs",
+    "putc", "_IO_putc", "fseek", "fgetpos", "fsetpos", "printf", "fprintf",
+    "sprintf", "vprintf", "vfprintf", "vsprintf", "scanf", "fscanf", "sscanf",
+    "__assert_fail", "modf", "free", "pthread_join", "pthread_mutex_lock",
+    "pthread_mutex_unlock", "pthread_mutex_init", "pthread_mutex_destroy"
+  };
+  for (size_t i = 0; i < array_lengthof(NoEffect); ++i) {
+    if (Name == NoEffect[i])
+      return;
+  }
+
+  // *dst = *src
+  if (Name == "memmove" || Name == "memcpy") {
+    if (CS.arg_size() >= 2) {
+      join(getPointee(getPointee(getNode(CS.getArgument(0)))),
+           getPointee(getPointee(getNode(CS.getArgument(1)))));
+      addAssign(I, CS.getArgument(0));
+      return;
+    }
+  }
+
+  // The result points into an argument.
+  int Returned = -1;
+  if (Name == "realloc" || Name == "strchr" || Name == "strrchr" ||
+      Name == "strstr" || Name == "strtok" || Name == "stpcpy" ||
+      Name == "getcwd" || Name == "strcat" || Name == "strcpy")
+    Returned = 0;
+  else if (Name == "realpath")
+    Returned = 1;
+  else if (Name == "freopen")
+    Returned = 2;
+  if (Returned >= 0 && (unsigned)Returned < CS.arg_size()) {
+    addAssign(I, CS.getArgument(Returned));
+    return;
+  }
+
+  // The thread function gets the last argument, and what it returns goes
+  // to pthread_join.
+  if (Name == "pthread_create" && CS.arg_size() == 4) {
+    unsigned Callee = getPointee(getNode(CS.getArgument(2)));
+    unsigned Arg = getPointee(getNode(CS.getArgument(3)));
+    unsigned S = getSignature(Callee, 1);
+    join(getPointee(Signatures[S][1]), Arg);
+    S = getSignature(Callee, 1);
+    join(getPointee(Signatures[S][0]), Unknown);
+    return;
+  }
+
+  // Anything else may read and write whatever its arguments reach, and
+  // return anything.
+  addUnknown(I);
+  for (unsigned i = 0; i < CS.arg_size(); ++i)
+    addUnknown(CS.getArgument(i));
+}
+
+void SteensgaardPointerAnalysis::releaseMemory() {
+  Parent.clear();
+  Rank.clear();
+  Pointee.clear();
+  Signature.clear();
+  Signatures.clear();
+  ValueNodes.clear();
+  ObjectNodes.clear();
+  ReturnNodes.clear();
+  Allocators.clear();
+}
+
+void SteensgaardPointerAnalysis::getAllPointers(ValueList &Pointers) {
+  IDAssigner &IDA = getAnalysis<IDAssigner>();
+
+  Pointers.clear();
+  for (unsigned i = 0; i < IDA.getNumValues(); ++i) {
+    Value *V = IDA.getValue(i);
+    if (V->getType()->isPointerTy() && !shouldFilterOut(V))
+      Pointers.push_back(V);
+  }
+}
+
+bool SteensgaardPointerAnalysis::getPointees(const Value *Pointer,
+                                             ValueList &Pointees) {
+  ArrayRef<Value *> Range;
+  if (!getPointeeRange(Pointer, Range))
+    return false;
+  Pointees.assign(Range.begin(), Range.end());
+  return true;
+}
+
+bool SteensgaardPointerAnalysis::getPointeeRange(const Value *Pointer,
+                                                 ArrayRef<Value *> &Pointees) {
+  assert(Pointer->getType()->isPointerTy() && "<Pointer> is not a pointer");
+
+  DenseMap<const Value *, unsigned>::const_iterator I =
+      ValueNodes.find(Pointer);
+  if (I == ValueNodes.end())
+    return false;
+
+  Pointees = ArrayRef<Value *>();
+  unsigned N = find(I->second);
+  if (Pointee[N] == None)
+    return true;
+  // External code may have put anything there.
+  if (find(Pointee[N]) == find(Unknown))
+    return false;
+  DenseMap<unsigned, ValueList>::const_iterator J =
+      Allocators.find(find(Pointee[N]));
+  if (J != Allocators.end())
+    Pointees = J->second;
+  return true;
+}
+
+void *SteensgaardPointerAnalysis::getAdjustedAnalysisPointer(AnalysisID PI) {
+  if (PI == &PointerAnalysis::ID)
+    return (PointerAnalysis *)this;
+  return this;
+}
@@ -22,6 +22,9 @@ if __name__ == '__main__':
                     'instead of value IDs (default: false)')
     parser.add_argument('--debug', action = 'store_true',
             help = 'Set it if you want debug output (default: false)')
+    parser.add_argument('--snapshot',
+            help = 'anders-aa only: the solved points-to graph is loaded ' \
+                    'from this file if it exists, and saved to it otherwise')
     args = parser.parse_args()
 
     cmd = rcs_utils.load_all_plugins('opt')
@@ -32,6 +35,11 @@ if __name__ == '__main__':
         # cmd = string.join((cmd, '-debug'))
     elif args.aa == 'anders-aa':
         cmd = rcs_utils.load_plugin(cmd, 'RCSAndersens')
+        if args.snapshot is not None:
+            if os.path.exists(args.snapshot):
+                cmd = string.join((cmd, '-anders-snapshot-in', args.snapshot))
+            else:
+                cmd = string.join((cmd, '-anders-snapshot-out', args.snapshot))
     elif args.aa == 'bc2bdd-aa':
         if not os.path.exists('bc2bdd.conf'):
             sys.stderr.write('\033[1;31m')
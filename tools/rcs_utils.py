@@ -17,8 +17,9 @@ def load_plugin(cmd, plugin):
 
 def load_all_plugins(cmd):
     cmd = load_plugin(cmd, 'libRCSID')
-    cmd = load_plugin(cmd, 'libRCSCFG')
+    # RCSCFG uses RCSPointerAnalysis.
     cmd = load_plugin(cmd, 'libRCSPointerAnalysis')
+    cmd = load_plugin(cmd, 'libRCSCFG')
     cmd = load_plugin(cmd, 'RCSSourceLocator')
     cmd = load_plugin(cmd, 'RCSAATester')
     return cmd